@@ -0,0 +1,198 @@
+/*
+ *  C Implementation: statx-batch benchmark
+ *
+ * Description: Lists a directory with and without the io_uring statx backend
+ *
+ *
+ *
+ * Copyright: See COPYING file that comes with this distribution
+ *
+ */
+
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include <cstdlib>
+#include <cstring>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <fmt/format.h>
+
+#include "logger.hxx"
+
+#include "vfs/vfs-statx-batch.hxx"
+
+/* rounds per backend, the fastest one is reported */
+#define BENCH_ROUNDS 3
+
+static void
+bench_count(const char* name, struct stat* file_stat, void* user_data)
+{
+    (void)name;
+    (void)file_stat;
+    ++*static_cast<std::size_t*>(user_data);
+}
+
+static bool
+bench_populate(const std::string& dir, std::size_t n_entries)
+{
+    for (std::size_t i = 0; i < n_entries; ++i)
+    {
+        const std::string file = fmt::format("{}/entry-{:08}", dir, i);
+        const int fd = open(file.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+        if (fd == -1)
+        {
+            fmt::print(stderr, "Failed to create {}: {}\n", file, std::strerror(errno));
+            return false;
+        }
+        close(fd);
+    }
+    return true;
+}
+
+static void
+bench_cleanup(const std::string& dir)
+{
+    DIR* dp = opendir(dir.c_str());
+    if (!dp)
+        return;
+    const struct dirent* ent;
+    while ((ent = readdir(dp)))
+    {
+        if (strncmp(ent->d_name, "entry-", 6) == 0)
+            unlinkat(dirfd(dp), ent->d_name, 0);
+    }
+    closedir(dp);
+    rmdir(dir.c_str());
+}
+
+static void
+bench_drop_caches()
+{
+    sync();
+    const int fd = open("/proc/sys/vm/drop_caches", O_WRONLY | O_CLOEXEC);
+    if (fd == -1 || write(fd, "3", 1) != 1)
+        fmt::print(stderr, "Failed to drop caches, run as root for cold cache numbers\n");
+    if (fd != -1)
+        close(fd);
+}
+
+/* same pattern as vfs_dir_load_thread(): read the names, stat them in batches */
+static double
+bench_list(const std::string& dir, bool use_uring, std::size_t* n_stated)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    DIR* dp = opendir(dir.c_str());
+    if (!dp)
+        return -1;
+    VFSStatxBatch* batch = vfs_statx_batch_new(dirfd(dp), bench_count, n_stated);
+    vfs_statx_batch_use_uring(batch, use_uring);
+
+    const struct dirent* ent;
+    while ((ent = readdir(dp)))
+    {
+        if (strcmp(ent->d_name, ".") && strcmp(ent->d_name, ".."))
+            vfs_statx_batch_add(batch, ent->d_name);
+    }
+    vfs_statx_batch_flush(batch);
+    vfs_statx_batch_free(batch);
+    closedir(dp);
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+int
+main(int argc, char** argv)
+{
+    std::size_t n_entries = 1000000;
+    const char* dir_arg = nullptr;
+    bool cold = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--cold"))
+            cold = true;
+        else if (!strcmp(argv[i], "--dir") && i + 1 < argc)
+            dir_arg = argv[++i];
+        else if (!strcmp(argv[i], "--entries") && i + 1 < argc)
+            n_entries = std::strtoul(argv[++i], nullptr, 10);
+        else
+        {
+            fmt::print(stderr, "Usage: {} [--entries N] [--dir DIR] [--cold]\n", argv[0]);
+            fmt::print(stderr, "  --entries N  entries in the generated dir, default 1000000\n");
+            fmt::print(stderr, "  --dir DIR    list an existing dir instead of generating one\n");
+            fmt::print(stderr, "  --cold       drop the page and inode caches before each round\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    SpaceFM::Logger::Init();
+
+    std::string dir;
+    if (dir_arg)
+        dir = dir_arg;
+    else
+    {
+        char tmpl[] = "/tmp/statx-batch-bench-XXXXXX";
+        if (!mkdtemp(tmpl))
+        {
+            fmt::print(stderr, "Failed to create a temporary dir: {}\n", std::strerror(errno));
+            return EXIT_FAILURE;
+        }
+        dir = tmpl;
+        fmt::print("Creating {} entries in {}\n", n_entries, dir);
+        if (!bench_populate(dir, n_entries))
+        {
+            bench_cleanup(dir);
+            return EXIT_FAILURE;
+        }
+    }
+
+    double best[2] = {0, 0};
+    std::size_t n_stated[2] = {0, 0};
+    for (int round = 0; round < BENCH_ROUNDS; ++round)
+    {
+        // backends take turns so neither always runs on the cache the other warmed
+        for (int use_uring = 0; use_uring < 2; ++use_uring)
+        {
+            if (cold)
+                bench_drop_caches();
+            n_stated[use_uring] = 0;
+            const double elapsed = bench_list(dir, use_uring, &n_stated[use_uring]);
+            if (elapsed < 0)
+            {
+                fmt::print(stderr, "Failed to open {}: {}\n", dir, std::strerror(errno));
+                return EXIT_FAILURE;
+            }
+            if (round == 0 || elapsed < best[use_uring])
+                best[use_uring] = elapsed;
+        }
+    }
+
+#ifndef HAVE_LIBURING
+    fmt::print("Built without liburing, both rows use fstatat()\n");
+#endif
+    const char* names[2] = {"fstatat", "io_uring"};
+    for (int i = 0; i < 2; ++i)
+    {
+        fmt::print("{:<10} {:>10} entries {:>9.3f} s {:>12.0f} entries/s\n",
+                   names[i],
+                   n_stated[i],
+                   best[i],
+                   best[i] > 0 ? n_stated[i] / best[i] : 0);
+    }
+#ifdef HAVE_LIBURING
+    if (best[1] > 0)
+        fmt::print("speedup    {:.2f}x\n", best[0] / best[1]);
+#endif
+
+    if (!dir_arg)
+        bench_cleanup(dir);
+    return EXIT_SUCCESS;
+}
@@ -6,6 +6,8 @@
 
 #include <string>
 #include <filesystem>
+#include <unordered_map>
+#include <vector>
 
 #include <iostream>
 #include <fstream>
@@ -289,151 +291,208 @@ get_rule_next(char** s, int* sub, int* comp, char** value)
     return true;
 }
 
-int
-xset_context_test(XSetContext* context, char* rules, bool def_disable)
+/* Rules of a context string, parsed once and looked up by the string */
+#define CONTEXT_RULES_CACHE_MAX 4096
+
+enum ItemPropContextTest
+{
+    ANY,
+    ALL,
+    NANY,
+    NALL
+};
+
+struct ContextRuleTerm
+{
+    std::string value;
+    std::string value_down; // CONTEXT_COMP_MATCH without uppercase chars
+    bool match_case;
+    long number; // CONTEXT_COMP_LESS, CONTEXT_COMP_GREATER
+    int sep_type; // 1 = ||, 2 = &&, 0 = last term
+};
+
+struct ContextRule
 {
-    // assumes valid xset_context and rules != nullptr and no global ignore
-    int i;
-    int sep_type;
     int sub;
     int comp;
-    char* value;
-    int match, action;
-    char* s;
-    char* eleval;
-    char* sep;
-    bool test;
-    enum ItemPropContextTest
+    std::vector<ContextRuleTerm> terms;
+};
+
+struct ContextRules
+{
+    bool valid;
+    int action;
+    int match;
+    std::vector<ContextRule> rules;
+};
+
+static std::unordered_map<std::string, ContextRules> context_rules_cache;
+
+static void
+context_rule_compile_terms(ContextRule& rule, const char* value)
+{
+    // "||" is split first, "&&" only once no "||" is left
+    const char* eleval = value;
+    do
     {
-        ANY,
-        ALL,
-        NANY,
-        NALL
-    };
+        ContextRuleTerm term;
+        const char* sep;
+        if ((sep = strstr(eleval, "||")))
+            term.sep_type = 1;
+        else if ((sep = strstr(eleval, "&&")))
+            term.sep_type = 2;
+        else
+            term.sep_type = 0;
+
+        const char* end = sep ? sep : eleval + strlen(eleval);
+        if (sep)
+        {
+            // remove trailing spaces from eleval
+            while (end > eleval && end[-1] == ' ')
+                end--;
+        }
+        term.value.assign(eleval, end - eleval);
+
+        char* down = g_utf8_strdown(term.value.c_str(), -1);
+        term.value_down = down;
+        g_free(down);
+        // pattern contains uppercase chars - test case sensitive
+        term.match_case = term.value != term.value_down;
+        term.number = strtol(term.value.c_str(), nullptr, 10);
+        rule.terms.push_back(term);
+
+        if (!sep)
+            break;
+        eleval = sep + 2;
+        while (eleval[0] == ' ')
+            eleval++;
+    } while (eleval[0] != '\0');
+}
+
+static const ContextRules*
+context_rules_get(char* rules)
+{
+    auto it = context_rules_cache.find(rules);
+    if (it != context_rules_cache.end())
+        return &it->second;
+
+    ContextRules compiled;
+    compiled.valid = false;
 
     // get valid action and match
     char* elements = rules;
-    if (!(s = get_element_next(&elements)))
-        return 0;
-    action = strtol(s, nullptr, 10);
-    g_free(s);
-    if (action < 0 || action > 3)
-        return 0;
+    char* s;
+    if ((s = get_element_next(&elements)))
+    {
+        compiled.action = strtol(s, nullptr, 10);
+        g_free(s);
+        if (compiled.action >= 0 && compiled.action <= 3 && (s = get_element_next(&elements)))
+        {
+            compiled.match = strtol(s, nullptr, 10);
+            g_free(s);
+            compiled.valid = compiled.match >= 0 && compiled.match <= 3;
+        }
+    }
 
-    if (!(s = get_element_next(&elements)))
-        return 0;
-    match = strtol(s, nullptr, 10);
-    g_free(s);
-    if (match < 0 || match > 3)
+    // parse rules
+    int sub;
+    int comp;
+    char* value;
+    while (compiled.valid && get_rule_next(&elements, &sub, &comp, &value))
+    {
+        ContextRule rule;
+        rule.sub = sub;
+        rule.comp = comp;
+        context_rule_compile_terms(rule, value);
+        compiled.rules.push_back(rule);
+        g_free(value);
+    }
+
+    if (context_rules_cache.size() >= CONTEXT_RULES_CACHE_MAX)
+        context_rules_cache.clear();
+    return &context_rules_cache.emplace(rules, compiled).first->second;
+}
+
+static const char*
+context_var_down(XSetContext* context, int sub)
+{
+    if (!context->var_down[sub])
+        context->var_down[sub] = g_utf8_strdown(context->var[sub], -1);
+    return context->var_down[sub];
+}
+
+static bool
+context_rule_test(XSetContext* context, const ContextRule& rule, const ContextRuleTerm& term)
+{
+    const char* var = context->var[rule.sub];
+    const char* eleval = term.value.c_str();
+    bool test;
+
+    switch (rule.comp)
+    {
+        case CONTEXT_COMP_EQUALS:
+            return !strcmp(var, eleval);
+        case CONTEXT_COMP_NEQUALS:
+            return strcmp(var, eleval);
+        case CONTEXT_COMP_CONTAINS:
+            return !!strstr(var, eleval);
+        case CONTEXT_COMP_NCONTAINS:
+            return !strstr(var, eleval);
+        case CONTEXT_COMP_BEGINS:
+            return g_str_has_prefix(var, eleval);
+        case CONTEXT_COMP_NBEGINS:
+            return !g_str_has_prefix(var, eleval);
+        case CONTEXT_COMP_ENDS:
+            return g_str_has_suffix(var, eleval);
+        case CONTEXT_COMP_NENDS:
+            return !g_str_has_suffix(var, eleval);
+        case CONTEXT_COMP_LESS:
+            return strtol(var, nullptr, 10) < term.number;
+        case CONTEXT_COMP_GREATER:
+            return strtol(var, nullptr, 10) > term.number;
+        case CONTEXT_COMP_MATCH:
+        case CONTEXT_COMP_NMATCH:
+            if (term.match_case)
+                test = fnmatch(eleval, var, 0);
+            else
+                test = fnmatch(term.value_down.c_str(), context_var_down(context, rule.sub), 0);
+            if (rule.comp == CONTEXT_COMP_MATCH)
+                test = !test;
+            return test;
+        default:
+            return false;
+    }
+}
+
+int
+xset_context_test(XSetContext* context, char* rules, bool def_disable)
+{
+    // assumes valid xset_context and rules != nullptr and no global ignore
+    const ContextRules* compiled = context_rules_get(rules);
+    if (!compiled->valid)
         return 0;
 
+    const int action = compiled->action;
+    const int match = compiled->match;
+
     if (action != CONTEXT_HIDE && action != CONTEXT_SHOW && def_disable)
         return CONTEXT_DISABLE;
 
-    // parse rules
-    bool is_rules = false;
+    if (compiled->rules.empty())
+        return CONTEXT_SHOW;
+
     bool all_match = true;
     bool no_match = true;
     bool any_match = false;
-    while (get_rule_next(&elements, &sub, &comp, &value))
+    for (const ContextRule& rule: compiled->rules)
     {
-        is_rules = true;
-
-        eleval = value;
-        do
+        bool test = false;
+        for (const ContextRuleTerm& term: rule.terms)
         {
-            if ((sep = strstr(eleval, "||")))
-                sep_type = 1;
-            else if ((sep = strstr(eleval, "&&")))
-                sep_type = 2;
-
-            if (sep)
-            {
-                sep[0] = '\0';
-                i = -1;
-                // remove trailing spaces from eleval
-                while (sep + i >= eleval && sep[i] == ' ')
-                {
-                    sep[i] = '\0';
-                    i--;
-                }
-            }
-
-            switch (comp)
-            {
-                case CONTEXT_COMP_EQUALS:
-                    test = !strcmp(context->var[sub], eleval);
-                    break;
-                case CONTEXT_COMP_NEQUALS:
-                    test = strcmp(context->var[sub], eleval);
-                    break;
-                case CONTEXT_COMP_CONTAINS:
-                    test = !!strstr(context->var[sub], eleval);
-                    break;
-                case CONTEXT_COMP_NCONTAINS:
-                    test = !strstr(context->var[sub], eleval);
-                    break;
-                case CONTEXT_COMP_BEGINS:
-                    test = g_str_has_prefix(context->var[sub], eleval);
-                    break;
-                case CONTEXT_COMP_NBEGINS:
-                    test = !g_str_has_prefix(context->var[sub], eleval);
-                    break;
-                case CONTEXT_COMP_ENDS:
-                    test = g_str_has_suffix(context->var[sub], eleval);
-                    break;
-                case CONTEXT_COMP_NENDS:
-                    test = !g_str_has_suffix(context->var[sub], eleval);
-                    break;
-                case CONTEXT_COMP_LESS:
-                    test = strtol(context->var[sub], nullptr, 10) < strtol(eleval, nullptr, 10);
-                    break;
-                case CONTEXT_COMP_GREATER:
-                    test = strtol(context->var[sub], nullptr, 10) > strtol(eleval, nullptr, 10);
-                    break;
-                case CONTEXT_COMP_MATCH:
-                case CONTEXT_COMP_NMATCH:
-                    s = g_utf8_strdown(eleval, -1);
-                    if (g_strcmp0(eleval, s))
-                    {
-                        // pattern contains uppercase chars - test case sensitive
-                        test = fnmatch(eleval, context->var[sub], 0);
-                    }
-                    else
-                    {
-                        // case insensitive
-                        char* str = g_utf8_strdown(context->var[sub], -1);
-                        test = fnmatch(s, str, 0);
-                        g_free(str);
-                    }
-                    g_free(s);
-                    if (comp == CONTEXT_COMP_MATCH)
-                        test = !test;
-                    break;
-                default:
-                    test = match == NANY || match == NALL; // failsafe
-            }
-
-            if (sep)
-            {
-                if (test)
-                {
-                    if (sep_type == 1) // ||
-                        break;
-                }
-                else
-                {
-                    if (sep_type == 2) // &&
-                        break;
-                }
-                eleval = sep + 2;
-                while (eleval[0] == ' ')
-                    eleval++;
-            }
-            else
-                eleval[0] = '\0';
-        } while (eleval[0] != '\0');
-        g_free(value);
+            test = context_rule_test(context, rule, term);
+            if ((term.sep_type == 1 && test) || (term.sep_type == 2 && !test))
+                break;
+        }
 
         if (test)
         {
@@ -450,9 +509,6 @@ xset_context_test(XSetContext* context, char* rules, bool def_disable)
         }
     }
 
-    if (!is_rules)
-        return CONTEXT_SHOW;
-
     bool is_match;
     switch (match)
     {
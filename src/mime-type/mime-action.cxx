@@ -18,11 +18,20 @@
 
 #include <string>
 #include <filesystem>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <algorithm>
+
+#include <memory>
+#include <mutex>
 
 #include <unistd.h>
 #include <fcntl.h>
 
 #include "vfs/vfs-user-dir.hxx"
+#include "vfs/vfs-app-desktop.hxx"
 
 #include "logger.hxx"
 
@@ -47,57 +56,263 @@ save_to_file(const char* path, const char* data, long len)
 static const char group_desktop[] = "Desktop Entry";
 static const char key_mime_type[] = "MimeType";
 
-typedef char* (*DataDirFunc)(const char* dir, const char* mime_type, void* user_data);
+/*
+ * The association lists and desktop file locations of all data dirs,
+ * built on first use and dropped by mime_type_actions_reload(), so
+ * building a context menu does not parse the lists again.
+ */
 
-static char*
-data_dir_foreach(DataDirFunc func, const char* mime_type, void* user_data)
+enum MimeAppsGroup
 {
-    char* ret = nullptr;
+    MIME_APPS_DEFAULT,
+    MIME_APPS_ADDED,
+    MIME_APPS_REMOVED,
+    MIME_APPS_CACHE,
+    MIME_APPS_N_GROUPS
+};
+
+static const char* const mime_apps_groups[] = {"Default Applications",
+                                               "Added Associations",
+                                               "Removed Associations",
+                                               "MIME Cache"};
+
+enum MimeAppsFile
+{
+    MIME_APPS_LIST,     /* mimeapps.list */
+    MIME_APPS_INFO,     /* mimeinfo.cache */
+    MIME_APPS_DEFAULTS, /* defaults.list */
+    MIME_APPS_N_FILES
+};
 
-    // $XDG_CONFIG_HOME=[~/.config]/mimeapps.list
-    if ((ret = func(vfs_user_config_dir(), mime_type, user_data)))
-        return ret;
+static const char* const mime_apps_files[] = {"mimeapps.list", "mimeinfo.cache", "defaults.list"};
 
-    // $XDG_DATA_HOME=[~/.local]/applications/mimeapps.list
-    char* dir = g_build_filename(vfs_user_data_dir(), "applications", nullptr);
-    if ((ret = func(dir, mime_type, user_data)))
+/* one parsed mimeapps.list, mimeinfo.cache or defaults.list */
+struct MimeAppsList
+{
+    bool loaded; /* the file exists */
+    std::unordered_map<std::string, std::vector<std::string>> groups[MIME_APPS_N_GROUPS];
+};
+
+/* a dir holding association lists */
+struct MimeAppsDir
+{
+    std::string path;
+    MimeAppsList lists[MIME_APPS_N_FILES];
+};
+
+/* the applications dir of a data dir */
+struct MimeDesktopDir
+{
+    std::string path;
+    std::unordered_set<std::string> files;                   /* relative paths */
+    std::unordered_map<std::string, std::string> in_subdirs; /* file name, relative path */
+};
+
+/* keys of a desktop file compared by mime_type_has_action() */
+struct MimeDesktopKeys
+{
+    bool loaded;
+    std::vector<std::string> mime_types;
+    char* exec;
+    char* name;
+};
+
+struct MimeActionIndex
+{
+    std::vector<MimeAppsDir> apps_dirs;       /* ~/.config first, then applications dirs */
+    std::vector<MimeDesktopDir> desktop_dirs; /* user data dir first */
+
+    std::mutex desktop_keys_lock;
+    std::unordered_map<std::string, MimeDesktopKeys> desktop_keys; /* by path, read on use */
+
+    ~MimeActionIndex()
     {
-        g_free(dir);
-        return ret;
+        for (auto& [path, keys]: desktop_keys)
+        {
+            g_free(keys.exec);
+            g_free(keys.name);
+        }
     }
-    g_free(dir);
+};
 
-    // $XDG_DATA_DIRS=[/usr/[local/]share]/applications/mimeapps.list
-    const char* const* dirs = vfs_system_data_dir();
-    for (; *dirs; ++dirs)
+static std::shared_ptr<MimeActionIndex> action_index;
+static std::mutex action_index_lock;
+
+static void
+apps_list_load(MimeAppsList* list, const std::string& path)
+{
+    GKeyFile* file = g_key_file_new();
+    list->loaded = g_key_file_load_from_file(file, path.c_str(), G_KEY_FILE_NONE, nullptr);
+    if (list->loaded)
     {
-        dir = g_build_filename(*dirs, "applications", nullptr);
-        if ((ret = func(dir, mime_type, user_data)))
+        for (unsigned int k = 0; k < MIME_APPS_N_GROUPS; ++k)
         {
-            g_free(dir);
-            return ret;
+            char** types = g_key_file_get_keys(file, mime_apps_groups[k], nullptr, nullptr);
+            if (!types)
+                continue;
+            for (char** type = types; *type; ++type)
+            {
+                char** apps =
+                    g_key_file_get_string_list(file, mime_apps_groups[k], *type, nullptr, nullptr);
+                if (!apps)
+                    continue;
+                std::vector<std::string>& entry = list->groups[k][*type];
+                for (char** app = apps; *app; ++app)
+                {
+                    g_strstrip(*app);
+                    if ((*app)[0] != '\0')
+                        entry.emplace_back(*app);
+                }
+                g_strfreev(apps);
+            }
+            g_strfreev(types);
         }
-        g_free(dir);
     }
-    return ret;
+    g_key_file_free(file);
 }
 
-static char*
-apps_dir_foreach(DataDirFunc func, const char* mime_type, void* user_data)
+static void
+apps_dir_load(std::vector<MimeAppsDir>& apps_dirs, const char* path, bool is_config)
+{
+    MimeAppsDir& dir = apps_dirs.emplace_back();
+    dir.path = path;
+    for (unsigned int n = 0; n < MIME_APPS_N_FILES; ++n)
+    {
+        apps_list_load(&dir.lists[n], vfs_build_path(path, mime_apps_files[n]));
+        if (is_config)
+            break; // no mimeinfo.cache or defaults.list in ~/.config
+    }
+}
+
+static void
+desktop_dir_scan(MimeDesktopDir* dir, const std::string& sub_dir)
+{
+    const std::string path = sub_dir.empty() ? dir->path : vfs_build_path(dir->path, sub_dir);
+    GDir* gdir = g_dir_open(path.c_str(), 0, nullptr);
+    if (!gdir)
+        return;
+
+    const char* name;
+    while ((name = g_dir_read_name(gdir)))
+    {
+        const std::string rel_path = sub_dir.empty() ? name : vfs_build_path(sub_dir, name);
+        const std::string full_path = vfs_build_path(dir->path, rel_path);
+        if (std::filesystem::is_directory(full_path))
+            desktop_dir_scan(dir, rel_path);
+        else if (std::filesystem::is_regular_file(full_path))
+        {
+            dir->files.insert(rel_path);
+            if (!sub_dir.empty())
+                dir->in_subdirs.emplace(name, rel_path);
+        }
+    }
+    g_dir_close(gdir);
+}
+
+static void
+desktop_dir_load(std::vector<MimeDesktopDir>& desktop_dirs, const char* data_dir)
+{
+    MimeDesktopDir& dir = desktop_dirs.emplace_back();
+    dir.path = vfs_build_path(data_dir, "applications");
+    desktop_dir_scan(&dir, "");
+}
+
+static std::shared_ptr<MimeActionIndex>
+action_index_get()
 {
-    char* ret = nullptr;
-    const char* dir = vfs_user_data_dir();
+    std::lock_guard<std::mutex> lock(action_index_lock);
+    if (action_index)
+        return action_index;
 
-    if ((ret = func(dir, mime_type, user_data)))
-        return ret;
+    std::shared_ptr<MimeActionIndex> index = std::make_shared<MimeActionIndex>();
 
-    const char* const* dirs = vfs_system_data_dir();
-    for (; *dirs; ++dirs)
+    // $XDG_CONFIG_HOME=[~/.config]/mimeapps.list
+    apps_dir_load(index->apps_dirs, vfs_user_config_dir(), true);
+    // $XDG_DATA_HOME=[~/.local]/applications/mimeapps.list
+    apps_dir_load(index->apps_dirs,
+                  vfs_build_path(vfs_user_data_dir(), "applications").c_str(),
+                  false);
+    // $XDG_DATA_DIRS=[/usr/[local/]share]/applications/mimeapps.list
+    for (const char* const* dirs = vfs_system_data_dir(); *dirs; ++dirs)
+        apps_dir_load(index->apps_dirs, vfs_build_path(*dirs, "applications").c_str(), false);
+
+    desktop_dir_load(index->desktop_dirs, vfs_user_data_dir());
+    for (const char* const* dirs = vfs_system_data_dir(); *dirs; ++dirs)
+        desktop_dir_load(index->desktop_dirs, *dirs);
+
+    action_index = index;
+    return index;
+}
+
+void
+mime_type_actions_reload()
+{
     {
-        if ((ret = func(*dirs, mime_type, user_data)))
-            return ret;
+        std::lock_guard<std::mutex> lock(action_index_lock);
+        action_index.reset();
+    }
+    // parsed desktop files go stale along with their locations
+    vfs_app_desktop_cache_clear();
+}
+
+static const std::vector<std::string>*
+apps_list_lookup(const MimeAppsList& list, MimeAppsGroup group, const char* type)
+{
+    auto it = list.groups[group].find(type);
+    if (it == list.groups[group].end())
+        return nullptr;
+    return &it->second;
+}
+
+/* same search as _locate_desktop_file() in every applications dir */
+static const std::string
+index_locate_desktop_file(const MimeActionIndex* index, const char* desktop_id)
+{
+    const char* sep = strrchr(desktop_id, '-');
+    for (const MimeDesktopDir& dir: index->desktop_dirs)
+    {
+        if (dir.files.contains(desktop_id))
+            return vfs_build_path(dir.path, desktop_id);
+        if (sep)
+        {
+            std::string sub_path = desktop_id;
+            sub_path[sep - desktop_id] = '/';
+            if (dir.files.contains(sub_path))
+                return vfs_build_path(dir.path, sub_path);
+        }
+        // sfm 0.8.7 some desktop files listed by the app chooser are in subdirs
+        auto it = dir.in_subdirs.find(desktop_id);
+        if (it != dir.in_subdirs.end())
+            return vfs_build_path(dir.path, it->second);
     }
-    return ret;
+    return "";
+}
+
+static const MimeDesktopKeys&
+index_desktop_keys(MimeActionIndex* index, const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(index->desktop_keys_lock);
+    MimeDesktopKeys& keys = index->desktop_keys[path];
+    if (keys.loaded)
+        return keys;
+
+    GKeyFile* kf = g_key_file_new();
+    if (g_key_file_load_from_file(kf, path.c_str(), G_KEY_FILE_NONE, nullptr))
+    {
+        char** types =
+            g_key_file_get_string_list(kf, group_desktop, key_mime_type, nullptr, nullptr);
+        if (types)
+        {
+            for (char** type = types; *type; ++type)
+                keys.mime_types.emplace_back(*type);
+            g_strfreev(types);
+        }
+        keys.exec = g_key_file_get_string(kf, group_desktop, "Exec", nullptr);
+        keys.name = g_key_file_get_string(kf, group_desktop, "Name", nullptr);
+    }
+    g_key_file_free(kf);
+    keys.loaded = true;
+    return keys;
 }
 
 static void
@@ -140,47 +355,32 @@ strv_index(char** strv, const char* str)
 
 /* Determine removed associations for this type */
 static void
-remove_actions(const char* type, GArray* actions)
+remove_actions(const MimeActionIndex* index, const char* type, GArray* actions)
 { // sfm 0.7.7+ added
     // LOG_INFO("remove_actions( {} )", type);
-    GKeyFile* file = g_key_file_new();
 
-    // $XDG_CONFIG_HOME=[~/.config]/mimeapps.list
-    char* path = g_build_filename(vfs_user_config_dir(), "mimeapps.list", nullptr);
-    if (!g_key_file_load_from_file(file, path, G_KEY_FILE_NONE, nullptr))
-    {
-        // $XDG_DATA_HOME=[~/.local]/applications/mimeapps.list
-        g_free(path);
-        path = g_build_filename(vfs_user_data_dir(), "applications/mimeapps.list", nullptr);
-        if (!g_key_file_load_from_file(file, path, G_KEY_FILE_NONE, nullptr))
-        {
-            g_key_file_free(file);
-            g_free(path);
-            return;
-        }
-    }
-    g_free(path);
+    // $XDG_CONFIG_HOME=[~/.config]/mimeapps.list,
+    // else $XDG_DATA_HOME=[~/.local]/applications/mimeapps.list
+    const MimeAppsList* list = &index->apps_dirs[0].lists[MIME_APPS_LIST];
+    if (!list->loaded)
+        list = &index->apps_dirs[1].lists[MIME_APPS_LIST];
+    if (!list->loaded)
+        return;
 
-    unsigned long n_removed = 0;
-    char** removed =
-        g_key_file_get_string_list(file, "Removed Associations", type, &n_removed, nullptr);
-    if (removed)
+    const std::vector<std::string>* removed = apps_list_lookup(*list, MIME_APPS_REMOVED, type);
+    if (!removed)
+        return;
+    for (const std::string& app: *removed)
     {
-        unsigned long r;
-        for (r = 0; r < n_removed; ++r)
+        // LOG_INFO("    {}", app);
+        int i = strv_index((char**)actions->data, app.c_str());
+        if (i != -1)
         {
-            g_strstrip(removed[r]);
-            // LOG_INFO("    {}", removed[r]);
-            int i = strv_index((char**)actions->data, removed[r]);
-            if (i != -1)
-            {
-                // LOG_INFO("        ACTION-REMOVED");
-                g_array_remove_index(actions, i);
-            }
+            // LOG_INFO("        ACTION-REMOVED");
+            g_free(g_array_index(actions, char*, i));
+            g_array_remove_index(actions, i);
         }
     }
-    g_strfreev(removed);
-    g_key_file_free(file);
 }
 
 /*
@@ -190,97 +390,45 @@ remove_actions(const char* type, GArray* actions)
  * http://standards.freedesktop.org/mime-apps-spec/mime-apps-spec-latest.html
  *
  */
-static char*
-get_actions(const char* dir, const char* type, GArray* actions)
+static void
+get_actions(const MimeActionIndex* index, const MimeAppsDir& dir, const char* type,
+            GArray* actions)
 {
-    // LOG_INFO("get_actions( {}, {} )\n", dir, type);
-    char** removed = nullptr;
+    // LOG_INFO("get_actions( {}/, {} )", dir.path, type);
 
-    const char* names[] = {"mimeapps.list", "mimeinfo.cache"};
-    const char* groups[] = {"Default Applications", "Added Associations", "MIME Cache"};
-    // LOG_INFO("get_actions( {}/, {} )", dir, type);
-    for (unsigned int n = 0; n < G_N_ELEMENTS(names); n++)
+    // removed associations in this dir only apply to its mimeinfo.cache
+    const std::vector<std::string>* removed = nullptr;
+    if (dir.lists[MIME_APPS_LIST].loaded)
+        removed = apps_list_lookup(dir.lists[MIME_APPS_LIST], MIME_APPS_REMOVED, type);
+
+    const MimeAppsGroup groups[] = {MIME_APPS_DEFAULT, MIME_APPS_ADDED, MIME_APPS_CACHE};
+    for (unsigned int n = 0; n < 2; n++)
     {
-        char* path = g_build_filename(dir, names[n], nullptr);
-        // LOG_INFO( "    {}", path);
-        GKeyFile* file = g_key_file_new();
-        bool opened = g_key_file_load_from_file(file, path, G_KEY_FILE_NONE, nullptr);
-        g_free(path);
-        if (G_LIKELY(opened))
+        const MimeAppsList& list = dir.lists[n == 0 ? MIME_APPS_LIST : MIME_APPS_INFO];
+        if (!list.loaded)
+            continue;
+        // mimeinfo.cache has only MIME Cache; others don't have it
+        for (unsigned int k = (n == 0 ? 0 : 2); k < (n == 0 ? 2u : 3u); k++)
         {
-            unsigned long n_removed = 0;
-            if (n == 0)
+            const std::vector<std::string>* apps = apps_list_lookup(list, groups[k], type);
+            if (!apps)
+                continue;
+            for (const std::string& app: *apps)
             {
-                // get removed associations in this dir
-                removed = g_key_file_get_string_list(file,
-                                                     "Removed Associations",
-                                                     type,
-                                                     &n_removed,
-                                                     nullptr);
-            }
-            // mimeinfo.cache has only MIME Cache; others don't have it
-            int k;
-            for (k = (n == 0 ? 0 : 2); k < (n == 0 ? 2 : 3); k++)
-            {
-                // LOG_INFO("        {} [{}]", groups[k], k);
-                unsigned long n_apps = 0;
-                bool is_removed;
-                char** apps = g_key_file_get_string_list(file, groups[k], type, &n_apps, nullptr);
-                unsigned long i;
-                for (i = 0; i < n_apps; ++i)
+                // LOG_INFO("            {}", app);
+                if (removed && n > 0 &&
+                    std::find(removed->begin(), removed->end(), app) != removed->end())
+                    continue;
+                /* check for app existence */
+                if (-1 == strv_index((char**)actions->data, app.c_str()) &&
+                    !index_locate_desktop_file(index, app.c_str()).empty())
                 {
-                    g_strstrip(apps[i]);
-                    // LOG_INFO("            {}", apps[i]);
-                    // check if removed
-                    is_removed = false;
-                    if (removed && n > 0)
-                    {
-                        unsigned long r;
-                        for (r = 0; r < n_removed; ++r)
-                        {
-                            g_strstrip(removed[r]);
-                            if (!strcmp(removed[r], apps[i]))
-                            {
-                                // LOG_INFO("                REMOVED");
-                                is_removed = true;
-                                break;
-                            }
-                        }
-                    }
-                    if (!is_removed && -1 == strv_index((char**)actions->data, apps[i]))
-                    {
-                        /* check for app existence */
-                        path = mime_type_locate_desktop_file(nullptr, apps[i]);
-                        if (G_LIKELY(path))
-                        {
-                            // LOG_INFO("                EXISTS");
-                            g_array_append_val(actions, apps[i]);
-                            g_free(path);
-                        }
-                        else
-                        {
-                            // LOG_INFO("                MISSING");
-                            g_free(apps[i]);
-                        }
-                        apps[i] = nullptr; /* steal the string */
-                    }
-                    else
-                    {
-                        g_free(apps[i]);
-                        apps[i] = nullptr;
-                    }
+                    char* action = g_strdup(app.c_str());
+                    g_array_append_val(actions, action);
                 }
-                /* don't call g_strfreev since all strings in the array were
-                 * stolen or freed. */
-                g_free(apps);
             }
         }
-        g_key_file_free(file);
-        if (!g_strcmp0(dir, vfs_user_config_dir()))
-            break; // no mimeinfo.cache in ~/.config
     }
-    g_strfreev(removed);
-    return nullptr; /* return nullptr so the for_each operation doesn't stop. */
 }
 
 /*
@@ -297,10 +445,12 @@ mime_type_get_actions(const char* type)
     /* FIXME: actions of parent types should be added, too. */
 
     /* get all actions for this file type */
-    data_dir_foreach((DataDirFunc)get_actions, type, actions);
+    std::shared_ptr<MimeActionIndex> index = action_index_get();
+    for (const MimeAppsDir& dir: index->apps_dirs)
+        get_actions(index.get(), dir, type, actions);
 
     /* remove actions for this file type */ // sfm
-    remove_actions(type, actions);
+    remove_actions(index.get(), type, actions);
 
     /* ensure default app is in the list */
     if (G_LIKELY((default_app = mime_type_get_default_action(type))))
@@ -327,46 +477,40 @@ mime_type_get_actions(const char* type)
 
 /*
  * NOTE:
- * This API is very time consuming, but unfortunately, due to the damn poor design of
- * Freedesktop.org spec, all the insane checks here are necessary.  Sigh...  :-(
+ * Due to the damn poor design of Freedesktop.org spec, all the insane checks
+ * here are necessary.  Sigh...  :-(  The desktop files are only read once.
  */
 static bool
 mime_type_has_action(const char* type, const char* desktop_id)
 {
-    char* cmd = nullptr;
-    char* name = nullptr;
-    bool found = false;
+    const char* cmd = nullptr;
+    const char* name = nullptr;
     bool is_desktop = g_str_has_suffix(desktop_id, ".desktop");
 
+    std::shared_ptr<MimeActionIndex> index = action_index_get();
     if (is_desktop)
     {
-        char** types;
-        GKeyFile* kf = g_key_file_new();
-        char* filename = mime_type_locate_desktop_file(nullptr, desktop_id);
-        if (filename && g_key_file_load_from_file(kf, filename, G_KEY_FILE_NONE, nullptr))
+        const std::string filename = index_locate_desktop_file(index.get(), desktop_id);
+        if (!filename.empty())
         {
-            types = g_key_file_get_string_list(kf, group_desktop, key_mime_type, nullptr, nullptr);
-            if (-1 != strv_index(types, type))
+            const MimeDesktopKeys& keys = index_desktop_keys(index.get(), filename);
+            if (std::find(keys.mime_types.begin(), keys.mime_types.end(), type) !=
+                keys.mime_types.end())
             {
                 /* our mime-type is already found in the desktop file. no further check is needed */
-                found = true;
-            }
-            g_strfreev(types);
-
-            if (!found) /* get the content of desktop file for comparison */
-            {
-                cmd = g_key_file_get_string(kf, group_desktop, "Exec", nullptr);
-                name = g_key_file_get_string(kf, group_desktop, "Name", nullptr);
+                return true;
             }
+            /* get the content of desktop file for comparison */
+            cmd = keys.exec;
+            name = keys.name;
         }
-        g_free(filename);
-        g_key_file_free(kf);
     }
     else
     {
-        cmd = (char*)desktop_id;
+        cmd = desktop_id;
     }
 
+    bool found = false;
     char** actions = mime_type_get_actions(type);
     if (actions)
     {
@@ -380,45 +524,32 @@ mime_type_has_action(const char* type, const char* desktop_id)
             }
             else /* Then, try to match by "Exec" and "Name" keys */
             {
-                char* name2 = nullptr;
-                char* cmd2 = nullptr;
-                char* filename = nullptr;
-                GKeyFile* kf = g_key_file_new();
-                filename = mime_type_locate_desktop_file(nullptr, *action);
-                if (filename && g_key_file_load_from_file(kf, filename, G_KEY_FILE_NONE, nullptr))
+                const std::string filename = index_locate_desktop_file(index.get(), *action);
+                if (filename.empty())
+                    continue;
+                const MimeDesktopKeys& keys = index_desktop_keys(index.get(), filename);
+                const char* cmd2 = keys.exec;
+                if (cmd && cmd2 && !strcmp(cmd, cmd2)) /* 2 desktop files have same "Exec" */
                 {
-                    cmd2 = g_key_file_get_string(kf, group_desktop, "Exec", nullptr);
-                    if (cmd && cmd2 && !strcmp(cmd, cmd2)) /* 2 desktop files have same "Exec" */
+                    if (is_desktop)
                     {
-                        if (is_desktop)
+                        const char* name2 = keys.name;
+                        /* Then, check if the "Name" keys of 2 desktop files are the same. */
+                        if (name && name2 && !strcmp(name, name2))
                         {
-                            name2 = g_key_file_get_string(kf, group_desktop, "Name", nullptr);
-                            /* Then, check if the "Name" keys of 2 desktop files are the same. */
-                            if (name && name2 && !strcmp(name, name2))
-                            {
-                                /* Both "Exec" and "Name" keys of the 2 desktop files are
-                                 *  totally the same. So, despite having different desktop id
-                                 *  They actually refer to the same application. */
-                                found = true;
-                            }
-                            g_free(name2);
-                        }
-                        else
+                            /* Both "Exec" and "Name" keys of the 2 desktop files are
+                             *  totally the same. So, despite having different desktop id
+                             *  They actually refer to the same application. */
                             found = true;
+                        }
                     }
+                    else
+                        found = true;
                 }
-                g_free(filename);
-                g_free(cmd2);
-                g_key_file_free(kf);
             }
         }
         g_strfreev(actions);
     }
-    if (is_desktop)
-    {
-        g_free(cmd);
-        g_free(name);
-    }
     return found;
 }
 
@@ -510,6 +641,7 @@ make_custom_desktop_file(const char* desktop_id, const char* mime_type)
 
         /* execute update-desktop-database" to update mimeinfo.cache */
         update_desktop_database();
+        mime_type_actions_reload();
     }
     return cust;
 }
@@ -613,60 +745,40 @@ mime_type_locate_desktop_file(const char* dir, const char* desktop_id)
 {
     if (dir)
         return _locate_desktop_file(dir, nullptr, (void*)desktop_id);
-    return apps_dir_foreach((DataDirFunc)_locate_desktop_file, nullptr, (void*)desktop_id);
+
+    std::shared_ptr<MimeActionIndex> index = action_index_get();
+    const std::string path = index_locate_desktop_file(index.get(), desktop_id);
+    return path.empty() ? nullptr : g_strdup(path.c_str());
 }
 
 static char*
-get_default_action(const char* dir, const char* type, void* user_data)
+get_default_action(const MimeActionIndex* index, const MimeAppsDir& dir, const char* type)
 {
-    (void)user_data;
-    // LOG_INFO("get_default_action( {}, {} )", dir, type);
+    // LOG_INFO("get_default_action( {}, {} )", dir.path, type);
     // search these files in dir for the first existing default app
-    const char* names[] = {"mimeapps.list", "defaults.list"};
-    const char* groups[] = {"Default Applications", "Added Associations"};
+    const MimeAppsFile names[] = {MIME_APPS_LIST, MIME_APPS_DEFAULTS};
+    const MimeAppsGroup groups[] = {MIME_APPS_DEFAULT, MIME_APPS_ADDED};
 
     for (unsigned int n = 0; n < G_N_ELEMENTS(names); n++)
     {
-        char* path = g_build_filename(dir, names[n], nullptr);
-        // LOG_INFO("    path = {}", path);
-        GKeyFile* file = g_key_file_new();
-        bool opened = g_key_file_load_from_file(file, path, G_KEY_FILE_NONE, nullptr);
-        g_free(path);
-        if (opened)
+        const MimeAppsList& list = dir.lists[names[n]];
+        if (!list.loaded)
+            continue;
+        for (unsigned int k = 0; k < G_N_ELEMENTS(groups); k++)
         {
-            for (unsigned int k = 0; k < G_N_ELEMENTS(groups); k++)
+            const std::vector<std::string>* apps = apps_list_lookup(list, groups[k], type);
+            if (apps)
             {
-                unsigned long n_apps;
-                char** apps = g_key_file_get_string_list(file, groups[k], type, &n_apps, nullptr);
-                if (apps)
+                for (const std::string& app: *apps)
                 {
-                    unsigned long i;
-                    for (i = 0; i < n_apps; ++i)
-                    {
-                        g_strstrip(apps[i]);
-                        if (apps[i][0] != '\0')
-                        {
-                            // LOG_INFO("        {}", apps[i]);
-                            if ((path = mime_type_locate_desktop_file(nullptr, apps[i])))
-                            {
-                                // LOG_INFO("            EXISTS");
-                                g_free(path);
-                                path = g_strdup(apps[i]);
-                                g_strfreev(apps);
-                                g_key_file_free(file);
-                                return path;
-                            }
-                        }
-                    }
-                    g_strfreev(apps);
+                    // LOG_INFO("        {}", app);
+                    if (!index_locate_desktop_file(index, app.c_str()).empty())
+                        return g_strdup(app.c_str());
                 }
-                if (n == 1)
-                    break; // defaults.list doesn't have Added Associations
             }
+            if (n == 1)
+                break; // defaults.list doesn't have Added Associations
         }
-        g_key_file_free(file);
-        if (!g_strcmp0(dir, vfs_user_config_dir()))
-            break; // no defaults.list in ~/.config
     }
     return nullptr;
 }
@@ -685,7 +797,14 @@ char*
 mime_type_get_default_action(const char* type)
 {
     /* FIXME: need to check parent types if default action of current type is not set. */
-    return data_dir_foreach((DataDirFunc)get_default_action, type, nullptr);
+    std::shared_ptr<MimeActionIndex> index = action_index_get();
+    for (const MimeAppsDir& dir: index->apps_dirs)
+    {
+        char* ret = get_default_action(index.get(), dir, type);
+        if (ret)
+            return ret;
+    }
+    return nullptr;
 }
 
 /*
@@ -854,6 +973,7 @@ mime_type_update_association(const char* type, const char* desktop_id, int actio
         char* data = g_key_file_to_data(file, &len, nullptr);
         save_to_file(path, data, len);
         g_free(data);
+        mime_type_actions_reload();
     }
     g_key_file_free(file);
     g_free(path);
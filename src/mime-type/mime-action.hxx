@@ -75,5 +75,12 @@ char* mime_type_get_default_action(const char* type);
  */
 void mime_type_update_association(const char* type, const char* desktop_id, int action);
 
+/*
+ * Association lists and desktop file locations are read once and kept.
+ * Drop them after an applications dir or mimeapps.list changed, along
+ * with the parsed desktop files of vfs_app_desktop_cache_clear().
+ */
+void mime_type_actions_reload();
+
 /* Locate the file path of desktop file by desktop_id */
 char* mime_type_locate_desktop_file(const char* dir, const char* desktop_id);
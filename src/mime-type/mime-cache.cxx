@@ -19,6 +19,10 @@
  *      MA 02110-1301, USA.
  */
 
+#include <array>
+#include <vector>
+#include <algorithm>
+
 #include <cstdint>
 
 #ifdef HAVE_MMAP
@@ -36,13 +40,15 @@
 #define LIB_MAJOR_VERSION 1
 /* FIXME: since mime-cache 1.2, weight is splitted into three parts
  * only lower 8 bit contains weight, and higher bits are flags and case-sensitivity.
- * anyway, since we don't support weight at all, it'll be fixed later.
- * We claimed that we support 1.2 to cheat pcmanfm as a temporary quick dirty fix
- * for the broken file manager, but this should be correctly done in the future.
- * Weight and case-sensitivity are not handled now. */
+ * Weight and case-sensitivity are handled for suffixes,
+ * but not yet for literals and globs. */
 #define LIB_MAX_MINOR_VERSION 2
 #define LIB_MIN_MINOR_VERSION 0
 
+/* weight of a suffix leaf node */
+#define SUFFIX_WEIGHT_MASK         0xff
+#define SUFFIX_FLAG_CASE_SENSITIVE 0x100
+
 /* handle byte order here */
 #define VAL16(buffrer, idx) GUINT16_FROM_BE(*(uint16_t*)(buffer + idx))
 #define VAL32(buffer, idx)  GUINT32_FROM_BE(*(uint32_t*)(buffer + idx))
@@ -58,6 +64,59 @@
 #define MAGIC_LIST     24
 #define NAMESPACE_LIST 28
 
+/* A glob split around its wildcards. Most globs in the glob list have a
+ * literal prefix ("README*") or suffix ("*.[1-9]", "*~"), so only the
+ * globs sharing the first or last byte of a file name are ever tried. */
+struct MimeGlob
+{
+    const char* glob;
+    const char* type;
+    uint32_t index; /* position in the cache, earlier wins among equal lengths */
+    uint32_t len;
+    uint32_t prefix_len;
+    uint32_t suffix_len;
+    bool literal;   /* no wildcards at all */
+    bool star_only; /* prefix*suffix, no need for fnmatch() */
+};
+
+struct MimeGlobIndex
+{
+    std::array<std::vector<MimeGlob>, 256> by_first;
+    std::array<std::vector<MimeGlob>, 256> by_last;
+    std::vector<MimeGlob> other;
+};
+
+/* Most magics can only match if one byte at a fixed offset has a known
+ * value, "\x89PNG" at 0 needs 0x89 at 0. Those are keyed by that byte,
+ * so sniffing only runs the full rules of the magics whose byte is there. */
+struct MimeMagicKey
+{
+    uint32_t offset;
+    unsigned char byte;
+    uint32_t magic; /* index in the magic list, which is sorted by priority */
+};
+
+struct MimeMagicOffset
+{
+    uint32_t offset;
+    uint32_t first; /* range of keys at this offset */
+    uint32_t last;
+};
+
+struct MimeMagicIndex
+{
+    std::vector<MimeMagicKey> keys;       /* sorted by offset, byte, magic */
+    std::vector<MimeMagicOffset> offsets; /* sorted by offset */
+    std::vector<uint32_t> unindexed;      /* magics that have to be tried anyway */
+};
+
+static void mime_cache_build_glob_index(MimeCache* cache);
+static void mime_cache_build_magic_index(MimeCache* cache);
+static uint32_t reverse_suffix_max_len(const char* buf, const char* nodes, uint32_t n,
+                                       uint32_t depth);
+static uint32_t reverse_suffix_max_bare(const char* buf, const char* nodes, uint32_t n,
+                                        uint32_t depth, uint32_t parent_ch);
+
 MimeCache*
 mime_cache_new(const char* file_path)
 {
@@ -79,6 +138,8 @@ mime_cache_unload(MimeCache* cache, bool clear)
 #endif
     }
     g_free(cache->file_path);
+    delete cache->glob_index;
+    delete cache->magic_index;
     if (clear)
         memset(cache, 0, sizeof(MimeCache));
 }
@@ -173,19 +234,56 @@ mime_cache_load(MimeCache* cache, const char* file_path)
     offset = VAL32(buffer, GLOB_LIST);
     cache->globs = buffer + offset + 4;
     cache->n_globs = VAL32(buffer, offset);
+    mime_cache_build_glob_index(cache);
 
     offset = VAL32(buffer, SUFFIX_TREE);
     cache->suffix_roots = buffer + VAL32(buffer + offset, 4);
     cache->n_suffix_roots = VAL32(buffer, offset);
+    if (cache->has_reverse_suffix)
+    {
+        cache->max_suffix =
+            reverse_suffix_max_len(buffer, cache->suffix_roots, cache->n_suffix_roots, 0);
+        cache->max_bare_suffix =
+            reverse_suffix_max_bare(buffer, cache->suffix_roots, cache->n_suffix_roots, 0, 0);
+    }
+    else
+    {
+        /* any part of the name can match */
+        cache->max_suffix = G_MAXUINT32;
+        cache->max_bare_suffix = G_MAXUINT32;
+    }
 
     offset = VAL32(buffer, MAGIC_LIST);
     cache->n_magics = VAL32(buffer, offset);
     cache->magic_max_extent = VAL32(buffer + offset, 4);
     cache->magics = buffer + VAL32(buffer + offset, 8);
+    mime_cache_build_magic_index(cache);
 
     return true;
 }
 
+/* (data & mask) == value, a word at a time */
+static bool
+magic_masked_equal(const char* data, const char* mask, const char* value, uint32_t len)
+{
+    uint32_t i = 0;
+    for (; i + 8 <= len; i += 8)
+    {
+        uint64_t d, m, v;
+        memcpy(&d, data + i, 8);
+        memcpy(&m, mask + i, 8);
+        memcpy(&v, value + i, 8);
+        if ((d & m) != v)
+            return false;
+    }
+    for (; i < len; ++i)
+    {
+        if ((data[i] & mask[i]) != value[i])
+            return false;
+    }
+    return true;
+}
+
 static bool
 magic_rule_match(const char* buf, const char* rule, const char* data, int len)
 {
@@ -205,15 +303,7 @@ magic_rule_match(const char* buf, const char* rule, const char* data, int len)
 
         if (G_UNLIKELY(mask_off > 0)) /* compare with mask applied */
         {
-            unsigned int i = 0;
-            const char* mask = buf + mask_off;
-
-            for (; i < val_len; ++i)
-            {
-                if ((data[offset + i] & mask[i]) != value[i])
-                    break;
-            }
-            if (i >= val_len)
+            if (magic_masked_equal(data + offset, buf + mask_off, value, val_len))
                 match = true;
         }
         else /* direct comparison */
@@ -256,16 +346,150 @@ magic_match(const char* buf, const char* magic, const char* data, int len)
     return false;
 }
 
+/* A top level rule checked at a single offset with at least one unmasked
+ * byte gives a key. A magic is indexed only if all its top level rules do. */
+static bool
+magic_rule_key(const char* buf, const char* rule, uint32_t* offset, unsigned char* byte)
+{
+    uint32_t range = VAL32(rule, 4);
+    uint32_t val_len = VAL32(rule, 12);
+    if (range != 1 || val_len == 0)
+        return false;
+
+    const char* value = buf + VAL32(rule, 16);
+    uint32_t mask_off = VAL32(rule, 20);
+    for (uint32_t i = 0; i < val_len; ++i)
+    {
+        if (mask_off == 0 || (unsigned char)buf[mask_off + i] == 0xff)
+        {
+            *offset = VAL32(rule, 0) + i;
+            *byte = value[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+/* FNV-1a, the layout of the cache file can change without the rules changing */
+static uint64_t
+magic_hash_update(uint64_t hash, const char* data, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; ++i)
+        hash = (hash ^ (unsigned char)data[i]) * 0x100000001b3ULL;
+    return hash;
+}
+
+static uint64_t
+magic_rule_hash(const char* buf, const char* rule, uint64_t hash)
+{
+    uint32_t val_len = VAL32(rule, 12);
+    uint32_t mask_off = VAL32(rule, 20);
+    uint32_t n_children = VAL32(rule, 24);
+
+    // offset, range, word size and value length
+    hash = magic_hash_update(hash, rule, 16);
+    hash = magic_hash_update(hash, buf + VAL32(rule, 16), val_len);
+    if (mask_off > 0)
+        hash = magic_hash_update(hash, buf + mask_off, val_len);
+    hash = magic_hash_update(hash, rule + 24, 4);
+
+    const char* child = buf + VAL32(rule, 28);
+    for (uint32_t i = 0; i < n_children; ++i, child += 32)
+        hash = magic_rule_hash(buf, child, hash);
+    return hash;
+}
+
+static void
+mime_cache_build_magic_index(MimeCache* cache)
+{
+    cache->magic_index = new MimeMagicIndex;
+    cache->magic_hash = 0xcbf29ce484222325ULL;
+
+    const char* magic = cache->magics;
+    std::vector<MimeMagicKey> keys;
+    for (uint32_t i = 0; i < cache->n_magics; ++i, magic += 16)
+    {
+        uint32_t n_rules = VAL32(magic, 8);
+        const char* rule = cache->buffer + VAL32(magic, 12);
+
+        const char* type = cache->buffer + VAL32(magic, 4);
+        cache->magic_hash = magic_hash_update(cache->magic_hash, magic, 4); // priority
+        cache->magic_hash = magic_hash_update(cache->magic_hash, type, strlen(type) + 1);
+        for (uint32_t j = 0; j < n_rules; ++j)
+            cache->magic_hash = magic_rule_hash(cache->buffer, rule + j * 32, cache->magic_hash);
+
+        keys.clear();
+        bool indexed = n_rules > 0;
+        for (uint32_t j = 0; indexed && j < n_rules; ++j, rule += 32)
+        {
+            MimeMagicKey key;
+            key.magic = i;
+            indexed = magic_rule_key(cache->buffer, rule, &key.offset, &key.byte);
+            keys.push_back(key);
+        }
+
+        if (indexed)
+            cache->magic_index->keys.insert(cache->magic_index->keys.end(),
+                                            keys.begin(),
+                                            keys.end());
+        else
+            cache->magic_index->unindexed.push_back(i);
+    }
+
+    std::sort(cache->magic_index->keys.begin(),
+              cache->magic_index->keys.end(),
+              [](const MimeMagicKey& a, const MimeMagicKey& b)
+              {
+                  if (a.offset != b.offset)
+                      return a.offset < b.offset;
+                  if (a.byte != b.byte)
+                      return a.byte < b.byte;
+                  return a.magic < b.magic;
+              });
+
+    const std::vector<MimeMagicKey>& sorted = cache->magic_index->keys;
+    for (uint32_t i = 0; i < sorted.size(); ++i)
+    {
+        if (i == 0 || sorted[i].offset != sorted[i - 1].offset)
+            cache->magic_index->offsets.push_back({sorted[i].offset, i, i});
+        cache->magic_index->offsets.back().last = i + 1;
+    }
+}
+
 const char*
 mime_cache_lookup_magic(MimeCache* cache, const char* data, int len)
 {
     const char* magic = cache->magics;
 
-    if (G_UNLIKELY(!data || (len == 0) || !magic))
+    if (G_UNLIKELY(!data || (len == 0) || !magic || !cache->magic_index))
         return nullptr;
 
-    for (unsigned int i = 0; i < cache->n_magics; ++i, magic += 16)
+    /* gather the magics whose key byte is present, in priority order,
+     * into a buffer kept per thread so a sniff does not allocate */
+    static thread_local std::vector<uint32_t> candidates;
+    const MimeMagicIndex* index = cache->magic_index;
+    candidates.assign(index->unindexed.begin(), index->unindexed.end());
+    for (const MimeMagicOffset& offset: index->offsets)
     {
+        if (offset.offset >= static_cast<uint32_t>(len))
+            break;
+        unsigned char byte = data[offset.offset];
+        auto first = index->keys.begin() + offset.first;
+        auto last = index->keys.begin() + offset.last;
+        first = std::lower_bound(first,
+                                 last,
+                                 byte,
+                                 [](const MimeMagicKey& key, unsigned char b)
+                                 { return key.byte < b; });
+        for (; first != last && first->byte == byte; ++first)
+            candidates.push_back(first->magic);
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    for (uint32_t i: candidates)
+    {
+        magic = cache->magics + i * 16;
         if (magic_match(cache->buffer, magic, data, len))
         {
             return cache->buffer + VAL32(magic, 4);
@@ -327,60 +551,145 @@ lookup_suffix_nodes(const char* buf, const char* nodes, uint32_t n, const char*
     return nullptr;
 }
 
+/* Pick the leaf with the highest weight among the leaves of a node,
+ * they come first in a group of siblings. */
+static const char*
+reverse_suffix_best_leaf(const char* nodes, uint32_t n, bool case_sensitive,
+                         uint32_t* best_weight)
+{
+    const char* ret = nullptr;
+    for (unsigned int i = 0; i < n; ++i)
+    {
+        const char* node = nodes + i * 12;
+        if (VAL32(node, 0) != 0)
+            break;
+
+        uint32_t flags = VAL32(node, 8);
+        if (!case_sensitive && (flags & SUFFIX_FLAG_CASE_SENSITIVE))
+            continue;
+        uint32_t weight = flags & SUFFIX_WEIGHT_MASK;
+        if (!ret || weight > *best_weight)
+        {
+            ret = node;
+            *best_weight = weight;
+        }
+    }
+    return ret;
+}
+
 /* Reverse suffix tree is used since mime.cache 1.1 (shared mime info 0.4)
- * Returns the address of the found "node", not mime-type.
- * FIXME: 1. Should be optimized with binary search
- *        2. Should consider weight of suffix nodes
+ * Siblings are sorted by char, so each char of the name is a binary search.
+ * Returns the address of the found leaf "node", not mime-type: the one with
+ * the highest weight, and the longest suffix among equal weights.
+ * When !case_sensitive the name is lowered and case-sensitive suffixes are skipped.
  */
 static const char*
 lookup_reverse_suffix_nodes(const char* buf, const char* nodes, uint32_t n, const char* name,
-                            const char* suffix, const char** suffix_pos)
+                            bool case_sensitive, const char** suffix_pos)
 {
     const char* ret = nullptr;
-    const char* cur_suffix_pos = (const char*)suffix + 1;
+    uint32_t ret_weight = 0;
+    const char* suffix = g_utf8_find_prev_char(name, name + strlen(name));
 
-    uint32_t uchar = suffix ? g_unichar_tolower(g_utf8_get_char(suffix)) : 0;
-    // LOG_DEBUG("{}: suffix= '{}'", name, suffix);
+    while (suffix && n > 0)
+    {
+        uint32_t uchar = g_utf8_get_char(suffix);
+        if (!case_sensitive)
+            uchar = g_unichar_tolower(uchar);
 
+        /* binary search */
+        const char* node = nullptr;
+        int lower = 0;
+        int upper = n - 1;
+        while (lower <= upper)
+        {
+            int middle = (lower + upper) / 2;
+            const char* middle_node = nodes + middle * 12;
+            uint32_t ch = VAL32(middle_node, 0);
+            if (uchar < ch)
+                upper = middle - 1;
+            else if (uchar > ch)
+                lower = middle + 1;
+            else
+            {
+                node = middle_node;
+                break;
+            }
+        }
+        if (!node)
+            break;
+
+        n = VAL32(node, 4);
+        nodes = buf + VAL32(node, 8);
+
+        /* a leaf among the children means the suffix ends here */
+        uint32_t weight;
+        const char* leaf = reverse_suffix_best_leaf(nodes, n, case_sensitive, &weight);
+        if (leaf && (!ret || weight >= ret_weight))
+        {
+            ret = leaf;
+            ret_weight = weight;
+            *suffix_pos = suffix;
+        }
+        suffix = g_utf8_find_prev_char(name, suffix);
+    }
+    return ret;
+}
+
+/* The longest suffix of all, no char further from the end of a name is looked at */
+static uint32_t
+reverse_suffix_max_len(const char* buf, const char* nodes, uint32_t n, uint32_t depth)
+{
+    uint32_t max_len = 0;
     for (unsigned int i = 0; i < n; ++i)
     {
         const char* node = nodes + i * 12;
         uint32_t ch = VAL32(node, 0);
-        const char* _suffix_pos = suffix;
-        if (G_LIKELY(ch))
+        if (ch == 0)
         {
-            if (ch == uchar)
-            {
-                uint32_t n_children = VAL32(node, 4);
-                uint32_t first_child_off = VAL32(node, 8);
-                const char* leaf_node =
-                    lookup_reverse_suffix_nodes(buf,
-                                                buf + first_child_off,
-                                                n_children,
-                                                name,
-                                                g_utf8_find_prev_char(name, suffix),
-                                                &_suffix_pos);
-                if (leaf_node && _suffix_pos < cur_suffix_pos)
-                {
-                    ret = leaf_node;
-                    cur_suffix_pos = _suffix_pos;
-                }
-            }
+            if (depth > max_len)
+                max_len = depth;
         }
-        else /* ch == 0 */
+        else
         {
-            /* uint32_t weight = VAL32(node, 8); */
-            /* suffix is found in the tree! */
+            uint32_t n_children = VAL32(node, 4);
+            uint32_t first_child_off = VAL32(node, 8);
+            uint32_t len =
+                reverse_suffix_max_len(buf, buf + first_child_off, n_children, depth + 1);
+            if (len > max_len)
+                max_len = len;
+        }
+    }
+    return max_len;
+}
 
-            if (suffix < cur_suffix_pos)
-            {
-                ret = node;
-                cur_suffix_pos = suffix;
-            }
+/* Most suffixes start with '.', only a few like "*~" or "*,v" do not.
+ * The longest of those tells how much of a name without dots can match. */
+static uint32_t
+reverse_suffix_max_bare(const char* buf, const char* nodes, uint32_t n, uint32_t depth,
+                        uint32_t parent_ch)
+{
+    uint32_t max_len = 0;
+    for (unsigned int i = 0; i < n; ++i)
+    {
+        const char* node = nodes + i * 12;
+        uint32_t ch = VAL32(node, 0);
+        if (ch == 0)
+        {
+            if (parent_ch != '.' && depth > max_len)
+                max_len = depth;
+        }
+        else
+        {
+            uint32_t n_children = VAL32(node, 4);
+            uint32_t first_child_off = VAL32(node, 8);
+            uint32_t len =
+                reverse_suffix_max_bare(buf, buf + first_child_off, n_children, depth + 1, ch);
+            if (len > max_len)
+                max_len = len;
         }
     }
-    *suffix_pos = cur_suffix_pos;
-    return ret;
+    return max_len;
 }
 
 const char*
@@ -395,13 +704,13 @@ mime_cache_lookup_suffix(MimeCache* cache, const char* filename, const char** su
         return nullptr;
     if (cache->has_reverse_suffix) /* since mime.cache ver: 1.1 */
     {
-        const char* suffix;
-        const char* leaf_node;
         const char* _suffix_pos = (const char*)-1;
-        int fn_len = strlen(filename);
-        suffix = g_utf8_find_prev_char(filename, filename + fn_len);
-        leaf_node =
-            lookup_reverse_suffix_nodes(cache->buffer, root, n, filename, suffix, &_suffix_pos);
+        /* as the spec says, try a case-sensitive match first, then the lowered name */
+        const char* leaf_node =
+            lookup_reverse_suffix_nodes(cache->buffer, root, n, filename, true, &_suffix_pos);
+        if (!leaf_node)
+            leaf_node =
+                lookup_reverse_suffix_nodes(cache->buffer, root, n, filename, false, &_suffix_pos);
         if (leaf_node)
         {
             mime_type = cache->buffer + VAL32(leaf_node, 4);
@@ -514,29 +823,119 @@ mime_cache_lookup_literal(MimeCache* cache, const char* filename)
     return lookup_str_in_entries(cache, cache->literals, cache->n_literals, filename);
 }
 
-const char*
-mime_cache_lookup_glob(MimeCache* cache, const char* filename, int* glob_len)
+static void
+mime_cache_build_glob_index(MimeCache* cache)
 {
+    cache->glob_index = new MimeGlobIndex;
+
     const char* entry = cache->globs;
-    const char* type = nullptr;
-    int max_glob_len = 0;
 
     /* entry size is changed in mime.cache 1.1 */
     std::size_t entry_size = cache->has_str_weight ? 12 : 8;
 
-    for (unsigned int i = 0; i < cache->n_globs; ++i)
+    for (unsigned int i = 0; i < cache->n_globs; ++i, entry += entry_size)
+    {
+        MimeGlob glob;
+        glob.glob = cache->buffer + VAL32(entry, 0);
+        glob.type = cache->buffer + VAL32(entry, 4);
+        glob.index = i;
+        glob.len = strlen(glob.glob);
+
+        const char* first = strpbrk(glob.glob, "*?[\\");
+        if (!first)
+        {
+            glob.literal = true;
+            glob.star_only = false;
+            glob.prefix_len = glob.len;
+            glob.suffix_len = 0;
+        }
+        else
+        {
+            const char* last = first;
+            for (const char* p = first; *p; ++p)
+            {
+                if (*p == '*' || *p == '?' || *p == '[' || *p == ']' || *p == '\\')
+                    last = p;
+            }
+            glob.literal = false;
+            glob.star_only = (first == last && *first == '*');
+            glob.prefix_len = first - glob.glob;
+            /* an escaped char is not literal, keep the whole tail for fnmatch() */
+            glob.suffix_len = strchr(glob.glob, '\\') ? 0 : glob.len - (last - glob.glob) - 1;
+        }
+
+        unsigned char first_byte = glob.glob[0];
+        if (glob.prefix_len > 0)
+            cache->glob_index->by_first[first_byte].push_back(glob);
+        else if (glob.suffix_len > 0)
+        {
+            unsigned char last_byte = glob.glob[glob.len - 1];
+            cache->glob_index->by_last[last_byte].push_back(glob);
+        }
+        else
+            cache->glob_index->other.push_back(glob);
+    }
+
+    /* longest first, so the first match of a bucket is its best one */
+    const auto longer = [](const MimeGlob& a, const MimeGlob& b)
+    { return a.len != b.len ? a.len > b.len : a.index < b.index; };
+    for (std::vector<MimeGlob>& bucket: cache->glob_index->by_first)
+        std::sort(bucket.begin(), bucket.end(), longer);
+    for (std::vector<MimeGlob>& bucket: cache->glob_index->by_last)
+        std::sort(bucket.begin(), bucket.end(), longer);
+    std::sort(cache->glob_index->other.begin(), cache->glob_index->other.end(), longer);
+}
+
+static const MimeGlob*
+glob_bucket_lookup(const std::vector<MimeGlob>& bucket, const char* filename, std::size_t len,
+                   const MimeGlob* best)
+{
+    for (const MimeGlob& glob: bucket)
     {
-        const char* glob = cache->buffer + VAL32(entry, 0);
-        int _glob_len;
-        if (fnmatch(glob, filename, 0) == 0 && (_glob_len = strlen(glob)) > max_glob_len)
+        /* sorted longest first, nothing left can beat the current match */
+        if (best && (glob.len < best->len || (glob.len == best->len && glob.index > best->index)))
+            break;
+
+        if (glob.literal)
         {
-            max_glob_len = _glob_len;
-            type = (cache->buffer + VAL32(entry, 4));
+            if (glob.len == len && memcmp(glob.glob, filename, len) == 0)
+                return &glob;
+            continue;
         }
-        entry += entry_size;
+        if (len < glob.prefix_len + glob.suffix_len ||
+            memcmp(glob.glob, filename, glob.prefix_len) ||
+            memcmp(glob.glob + glob.len - glob.suffix_len,
+                   filename + len - glob.suffix_len,
+                   glob.suffix_len))
+            continue;
+        if (glob.star_only || fnmatch(glob.glob, filename, 0) == 0)
+            return &glob;
     }
-    *glob_len = max_glob_len;
-    return type;
+    return best;
+}
+
+const char*
+mime_cache_lookup_glob(MimeCache* cache, const char* filename, int* glob_len)
+{
+    *glob_len = 0;
+    if (!cache->glob_index || !filename[0])
+        return nullptr;
+
+    std::size_t len = strlen(filename);
+    const MimeGlob* best = nullptr;
+
+    /* according to the mime.cache 1.0 spec, the longest glob wins */
+    const MimeGlobIndex* index = cache->glob_index;
+    unsigned char first_byte = filename[0];
+    unsigned char last_byte = filename[len - 1];
+    best = glob_bucket_lookup(index->by_first[first_byte], filename, len, best);
+    best = glob_bucket_lookup(index->by_last[last_byte], filename, len, best);
+    best = glob_bucket_lookup(index->other, filename, len, best);
+
+    if (!best)
+        return nullptr;
+    *glob_len = best->len;
+    return best->type;
 }
 
 const char**
@@ -23,6 +23,9 @@
 
 #include <glib.h>
 
+struct MimeGlobIndex;
+struct MimeMagicIndex;
+
 struct MimeCache
 {
     char* file_path;
@@ -42,18 +45,22 @@ struct MimeCache
 
     uint32_t n_globs;
     const char* globs;
+    MimeGlobIndex* glob_index; /* globs bucketed by their literal prefix or suffix */
 
     uint32_t n_suffix_roots;
     const char* suffix_roots;
+    uint32_t max_suffix;      /* chars in the longest suffix */
+    uint32_t max_bare_suffix; /* chars in the longest suffix not starting with '.' */
 
     uint32_t n_magics;
     uint32_t magic_max_extent;
     const char* magics;
+    MimeMagicIndex* magic_index; /* magics bucketed by a byte at a fixed offset */
+    uint64_t magic_hash;         /* changes only when the magic rules do */
 };
 
 MimeCache* mime_cache_new(const char* file_path);
 bool mime_cache_load(MimeCache* cache, const char* file_path);
-bool mime_cache_reload(MimeCache* cache);
 void mime_cache_free(MimeCache* cache);
 
 const char* mime_cache_lookup_literal(MimeCache* cache, const char* filename);
@@ -0,0 +1,291 @@
+/*
+ *  C Implementation: mime-desc-index
+ *
+ * Description: Index of mime type descriptions and icon names
+ *
+ *
+ *
+ * Copyright: See COPYING file that comes with this distribution
+ *
+ */
+
+#include <string>
+#include <filesystem>
+#include <unordered_map>
+#include <vector>
+
+#include <memory>
+#include <mutex>
+
+#include <sys/stat.h>
+
+#include <glib.h>
+
+#include "logger.hxx"
+
+#include "vfs/vfs-user-dir.hxx"
+
+#include "mime-type/mime-type.hxx"
+#include "mime-type/mime-desc-index.hxx"
+
+/*
+ * File layout:
+ *   "SFMI <version>\n<locale>\n<stamp>\n"
+ *   then for each type: type, description and icon name, NUL terminated
+ */
+
+#define DESC_INDEX_MAGIC   "SFMI"
+#define DESC_INDEX_VERSION 1
+
+struct MimeDescEntry
+{
+    std::string desc;
+    std::string icon;
+};
+
+struct MimeDescIndex
+{
+    std::string locale;
+    std::unordered_map<std::string, MimeDescEntry> entries;
+};
+
+struct MimeDescBuild
+{
+    unsigned int generation;
+    std::string file;
+    std::string header;
+    std::string locale;
+    std::vector<std::string> data_dirs; /* user data dir first */
+};
+
+static std::shared_ptr<const MimeDescIndex> desc_index;
+static std::mutex desc_index_lock;
+static unsigned int desc_index_generation = 0;
+
+static const std::string
+desc_index_locale()
+{
+    const char* const* langs = g_get_language_names();
+    const char* dot = strchr(langs[0], '.');
+    if (dot)
+        return std::string(langs[0], dot - langs[0]);
+    return langs[0];
+}
+
+/* update-mime-database rewrites mime.cache whenever an xml file changes */
+static const std::string
+desc_index_stamp(const std::vector<std::string>& data_dirs)
+{
+    std::string stamp;
+    for (const std::string& data_dir: data_dirs)
+    {
+        const std::string cache = data_dir + "/mime/mime.cache";
+        struct stat cache_stat;
+        if (stat(cache.c_str(), &cache_stat) == 0)
+            stamp.append(fmt::format("{}:{}.{}:{};",
+                                     cache,
+                                     cache_stat.st_mtim.tv_sec,
+                                     cache_stat.st_mtim.tv_nsec,
+                                     cache_stat.st_size));
+    }
+    return stamp;
+}
+
+static std::shared_ptr<MimeDescIndex>
+desc_index_read(const MimeDescBuild* build)
+{
+    char* contents;
+    gsize len;
+    if (!g_file_get_contents(build->file.c_str(), &contents, &len, nullptr))
+        return nullptr;
+
+    std::shared_ptr<MimeDescIndex> index;
+    const std::string& header = build->header;
+    if (len > header.size() && contents[len - 1] == '\0' &&
+        memcmp(contents, header.data(), header.size()) == 0)
+    {
+        index = std::make_shared<MimeDescIndex>();
+        index->locale = build->locale;
+
+        // every string is NUL terminated, the last one at the end of the file
+        const char* p = contents + header.size();
+        const char* end = contents + len;
+        while (p < end)
+        {
+            const char* type = p;
+            p += strlen(p) + 1;
+            if (p >= end)
+                break;
+            const char* desc = p;
+            p += strlen(p) + 1;
+            if (p >= end)
+                break;
+            const char* icon = p;
+            p += strlen(p) + 1;
+            index->entries.emplace(type, MimeDescEntry{desc, icon});
+        }
+    }
+    g_free(contents);
+    return index;
+}
+
+static void
+desc_index_write(const MimeDescBuild* build, const MimeDescIndex* index)
+{
+    std::string data = build->header;
+    for (const auto& [type, entry]: index->entries)
+    {
+        data.append(type.c_str(), type.size() + 1);
+        data.append(entry.desc.c_str(), entry.desc.size() + 1);
+        data.append(entry.icon.c_str(), entry.icon.size() + 1);
+    }
+
+    char* dir = g_path_get_dirname(build->file.c_str());
+    g_mkdir_with_parents(dir, 0700);
+    g_free(dir);
+
+    // written to a tmpfile and renamed over the old index
+    GError* error = nullptr;
+    if (!g_file_set_contents(build->file.c_str(), data.data(), data.size(), &error))
+    {
+        LOG_WARN("Failed to save mime description index {}: {}", build->file, error->message);
+        g_error_free(error);
+    }
+}
+
+/* Same search order as mime_type_get_desc_icon(), user data dir first */
+static std::shared_ptr<MimeDescIndex>
+desc_index_build(const MimeDescBuild* build)
+{
+    std::shared_ptr<MimeDescIndex> index = std::make_shared<MimeDescIndex>();
+    index->locale = build->locale;
+
+    for (std::size_t i = 0; i < build->data_dirs.size(); ++i)
+    {
+        const bool is_local = i == 0;
+        const std::filesystem::path mime_dir = build->data_dirs[i] + "/mime";
+
+        std::error_code ec;
+        for (const auto& media: std::filesystem::directory_iterator(mime_dir, ec))
+        {
+            if (!media.is_directory(ec) || media.path().filename() == "packages")
+                continue;
+
+            for (const auto& file: std::filesystem::directory_iterator(media.path(), ec))
+            {
+                if (file.path().extension() != ".xml")
+                    continue;
+
+                const std::string type =
+                    media.path().filename().string() + "/" + file.path().stem().string();
+                MimeDescEntry& entry = index->entries[type];
+                if (!entry.desc.empty())
+                    continue; // found in a dir with higher priority
+
+                char* icon = nullptr;
+                char* desc = mime_type_get_desc_icon_from_file(file.path().c_str(),
+                                                               build->locale.c_str(),
+                                                               is_local,
+                                                               &icon);
+                if (desc)
+                    entry.desc = desc;
+                if (icon)
+                    entry.icon = icon;
+                g_free(desc);
+                g_free(icon);
+            }
+        }
+    }
+    return index;
+}
+
+static void*
+desc_index_thread(void* user_data)
+{
+    MimeDescBuild* build = static_cast<MimeDescBuild*>(user_data);
+
+    std::shared_ptr<MimeDescIndex> index = desc_index_read(build);
+    if (!index)
+    {
+        index = desc_index_build(build);
+        desc_index_write(build, index.get());
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(desc_index_lock);
+        // a newer build was started meanwhile, or the library was finalized
+        if (build->generation == desc_index_generation)
+            desc_index = index;
+    }
+
+    delete build;
+    return nullptr;
+}
+
+static void
+desc_index_start()
+{
+    MimeDescBuild* build = new MimeDescBuild;
+
+    build->data_dirs.emplace_back(vfs_user_data_dir());
+    for (const char* const* dir = vfs_system_data_dir(); *dir; ++dir)
+        build->data_dirs.emplace_back(*dir);
+
+    build->locale = desc_index_locale();
+    build->file = vfs_build_path(vfs_user_cache_dir(), "spacefm", "mime-desc-index");
+    build->header = fmt::format("{} {}\n{}\n{}\n",
+                                DESC_INDEX_MAGIC,
+                                DESC_INDEX_VERSION,
+                                build->locale,
+                                desc_index_stamp(build->data_dirs));
+
+    {
+        std::lock_guard<std::mutex> lock(desc_index_lock);
+        build->generation = ++desc_index_generation;
+    }
+
+    g_thread_unref(g_thread_new("mime_desc_index", desc_index_thread, build));
+}
+
+void
+mime_desc_index_load()
+{
+    desc_index_start();
+}
+
+void
+mime_desc_index_reload()
+{
+    desc_index_start();
+}
+
+void
+mime_desc_index_clean()
+{
+    std::lock_guard<std::mutex> lock(desc_index_lock);
+    ++desc_index_generation;
+    desc_index.reset();
+}
+
+bool
+mime_desc_index_lookup(const char* type, const char* locale, char** desc, char** icon_name)
+{
+    std::shared_ptr<const MimeDescIndex> index;
+    {
+        std::lock_guard<std::mutex> lock(desc_index_lock);
+        index = desc_index;
+    }
+    if (!index || (locale && index->locale != locale))
+        return false;
+
+    *desc = nullptr;
+    auto it = index->entries.find(type);
+    if (it == index->entries.end())
+        return true; // no xml file for this type
+
+    if (!it->second.desc.empty())
+        *desc = g_strdup(it->second.desc.c_str());
+    if (icon_name && !*icon_name && !it->second.icon.empty())
+        *icon_name = g_strdup(it->second.icon.c_str());
+    return true;
+}
@@ -0,0 +1,35 @@
+/*
+ *  C Interface: mime-desc-index
+ *
+ * Description: Index of mime type descriptions and icon names
+ *
+ *
+ *
+ * Copyright: See COPYING file that comes with this distribution
+ *
+ */
+
+#pragma once
+
+/*
+ * The descriptions of all mime types in the current locale, and the icon
+ * names from user xml files, are read once in a background thread and
+ * saved in the cache dir. The saved index is reused as long as the locale
+ * and the mime.cache files it was built from are unchanged.
+ */
+
+/* load the saved index, or build it, in the background */
+void mime_desc_index_load();
+
+/* build a new index in the background after the mime database changed,
+ * the current one is used until it is ready */
+void mime_desc_index_reload();
+
+void mime_desc_index_clean();
+
+/*
+ * Look up type in the index, with the same results as
+ * mime_type_get_desc_icon(). Returns false if the index is not loaded yet
+ * or was built for another locale, then the xml files have to be read.
+ */
+bool mime_desc_index_lookup(const char* type, const char* locale, char** desc, char** icon_name);
@@ -19,10 +19,21 @@
  *      MA 02110-1301, USA.
  */
 
-/* Currently this library is NOT MT-safe */
+/* The loaded caches are never changed in place. A reload builds a new
+ * MimeCacheSet and publishes it, and the old set is freed when the last
+ * lookup still using it is done, so lookups can be done from any thread. */
 
 #include <string>
+#include <string_view>
 #include <filesystem>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <algorithm>
+
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 
 #include <cstdint>
 
@@ -34,6 +45,7 @@
 
 #include "mime-type/mime-type.hxx"
 #include "mime-type/mime-cache.hxx"
+#include "mime-type/mime-desc-index.hxx"
 
 /*
  * FIXME:
@@ -52,75 +64,225 @@
 /* max extent used to checking text files */
 #define TEXT_MAX_EXTENT 512
 
+/* entries kept in the suffix memo */
+#define SUFFIX_MEMO_MAX 4096
+
 const char xdg_mime_type_unknown[] = "application/octet-stream";
 const char xdg_mime_type_directory[] = "inode/directory";
 const char xdg_mime_type_executable[] = "application/x-executable";
 const char xdg_mime_type_plain_text[] = "text/plain";
 
-static void mime_cache_foreach(GFunc func, void* user_data);
 static bool mime_type_is_subclass(const char* type, const char* parent);
 
-static MimeCache** caches = nullptr;
-static unsigned int n_caches = 0;
-uint32_t mime_cache_max_extent = 0;
+/* Suffix lookups memoized by the part of the name they depend on,
+ * so all the "*.jpg" of a dir only walk the suffix trees once. */
+struct SuffixMemo
+{
+    int cache; /* index of the first cache with a match, or -1 */
+    const char* type;
+};
 
-/* allocated buffer used for mime magic checking to
-     prevent frequent memory allocation */
-static char* mime_magic_buf = nullptr;
-/* for MT safety, the buffer should be locked */
-G_LOCK_DEFINE_STATIC(mime_magic_buf);
+/* All mime.cache files on the system, user data dir first, with the
+ * values derived from them. Only the suffix memo changes after loading. */
+struct MimeCacheSet
+{
+    std::vector<MimeCache*> caches;
+    uint32_t max_extent{0};      /* max magic extent of all caches */
+    uint32_t max_suffix{0};      /* longest suffix */
+    uint32_t max_bare_suffix{0}; /* longest suffix not starting with '.' */
+    std::string stamp;           /* see mime_type_get_cache_stamp() */
 
-/* load all mime.cache files on the system,
- * including /usr/share/mime/mime.cache,
- * /usr/local/share/mime/mime.cache,
- * and $HOME/.local/share/mime/mime.cache. */
-static void mime_cache_load_all();
+    std::unordered_map<std::string, SuffixMemo> suffix_memo;
+    std::size_t suffix_memo_hand{0}; /* next bucket to evict from */
+    std::shared_mutex suffix_memo_lock;
 
-/* free all mime.cache files on the system */
-static void mime_cache_free_all();
+    ~MimeCacheSet()
+    {
+        for (MimeCache* cache: caches)
+            mime_cache_free(cache);
+    }
+};
+
+static std::shared_ptr<MimeCacheSet> cache_set;
+static std::mutex cache_set_lock;
+
+/* Types returned by lookups are interned, so they stay valid after the
+ * cache set they were found in is freed. There are only so many types. */
+struct MimeTypeHash
+{
+    using is_transparent = void;
+    std::size_t
+    operator()(std::string_view type) const
+    {
+        return std::hash<std::string_view>{}(type);
+    }
+};
+static std::unordered_set<std::string, MimeTypeHash, std::equal_to<>> type_pool;
+static std::shared_mutex type_pool_lock;
+
+/* buffer used for mime magic checking, one per thread so sniffing
+ * from several threads needs neither a lock nor an allocation per file */
+static thread_local std::vector<char> mime_magic_buf;
 
 static bool mime_type_is_data_plain_text(const char* data, int len);
 
-/*
- * Get mime-type of the specified file (quick, but less accurate):
- * Mime-type of the file is determined by cheking the filename only.
- * If statbuf != nullptr, it will be used to determine if the file is a directory.
- */
-const char*
-mime_type_get_by_filename(const char* filename, struct stat* statbuf)
+static const std::shared_ptr<MimeCacheSet>
+mime_cache_set_get()
 {
-    const char* type = nullptr;
-    const char* suffix_pos = nullptr;
-    const char* prev_suffix_pos = (const char*)-1;
-    MimeCache* cache;
+    std::lock_guard<std::mutex> lock(cache_set_lock);
+    return cache_set;
+}
 
-    if (G_UNLIKELY(statbuf && S_ISDIR(statbuf->st_mode)))
-        return XDG_MIME_TYPE_DIRECTORY;
+static const char*
+mime_type_intern(const char* type)
+{
+    if (!type)
+        return nullptr;
+    {
+        std::shared_lock<std::shared_mutex> lock(type_pool_lock);
+        auto it = type_pool.find(std::string_view(type));
+        if (it != type_pool.end())
+            return it->c_str();
+    }
+    std::unique_lock<std::shared_mutex> lock(type_pool_lock);
+    return type_pool.emplace(type).first->c_str();
+}
 
-    for (unsigned int i = 0; !type && i < n_caches; ++i)
+/* load the mime.cache files, including $HOME/.local/share/mime/mime.cache,
+ * /usr/local/share/mime/mime.cache and /usr/share/mime/mime.cache */
+static const std::shared_ptr<MimeCacheSet>
+mime_cache_set_load()
+{
+    std::shared_ptr<MimeCacheSet> set = std::make_shared<MimeCacheSet>();
+    for (const std::string& file: mime_type_get_cache_files())
     {
-        cache = caches[i];
-        type = mime_cache_lookup_literal(cache, filename);
-        if (G_LIKELY(!type))
+        // taken before loading, a change in between only makes the stamp outdated
+        struct stat file_stat;
+        if (stat(file.c_str(), &file_stat) == 0)
         {
-            const char* _type = mime_cache_lookup_suffix(cache, filename, &suffix_pos);
-            if (_type && suffix_pos < prev_suffix_pos)
-            {
-                type = _type;
-                prev_suffix_pos = suffix_pos;
-            }
+            set->stamp.append(file);
+            set->stamp.append(":" + std::to_string(file_stat.st_mtim.tv_sec) + "." +
+                              std::to_string(file_stat.st_mtim.tv_nsec) + ":" +
+                              std::to_string(file_stat.st_size) + ";");
         }
+
+        MimeCache* cache = mime_cache_new(file.c_str());
+        if (cache->magic_max_extent > set->max_extent)
+            set->max_extent = cache->magic_max_extent;
+        if (cache->buffer && cache->max_suffix > set->max_suffix)
+            set->max_suffix = cache->max_suffix;
+        if (cache->buffer && cache->max_bare_suffix > set->max_bare_suffix)
+            set->max_bare_suffix = cache->max_bare_suffix;
+        set->caches.push_back(cache);
+    }
+    return set;
+}
+
+/* Start of the last n chars of a name */
+static const char*
+suffix_memo_tail(const char* filename, const char* end, uint32_t n)
+{
+    const char* tail = end;
+    for (uint32_t i = 0; i < n && tail > filename; ++i)
+    {
+        tail = g_utf8_find_prev_char(filename, tail);
+        if (!tail)
+            return filename;
     }
+    return tail;
+}
+
+/* No suffix is longer than max_suffix chars, and one starting with '.' can only
+ * match from a '.' on, so the key is the name from the first '.' within the last
+ * max_suffix chars, or the last max_bare_suffix chars if longer.
+ * The case is kept: case-sensitive suffixes like "*.C" differ from "*.c". */
+static const std::string
+suffix_memo_key(MimeCacheSet* set, const char* filename)
+{
+    const char* end = filename + strlen(filename);
+    const char* reach = suffix_memo_tail(filename, end, set->max_suffix);
+    const char* start = (const char*)memchr(reach, '.', end - reach);
+    if (!start)
+        start = end;
+
+    const char* bare = suffix_memo_tail(filename, end, set->max_bare_suffix);
+    if (bare < start)
+        start = bare;
+
+    return std::string(start, end);
+}
+
+/* Drops one entry, taking the buckets in turn */
+static void
+suffix_memo_evict(MimeCacheSet* set)
+{
+    const std::size_t n_buckets = set->suffix_memo.bucket_count();
+    for (std::size_t i = 0; i < n_buckets; ++i)
+    {
+        const std::size_t bucket = set->suffix_memo_hand++ % n_buckets;
+        if (set->suffix_memo.bucket_size(bucket) > 0)
+        {
+            const std::string key = set->suffix_memo.begin(bucket)->first;
+            set->suffix_memo.erase(key);
+            return;
+        }
+    }
+}
+
+static SuffixMemo
+suffix_memo_lookup(MimeCacheSet* set, const char* filename)
+{
+    const std::string key = suffix_memo_key(set, filename);
+    {
+        std::shared_lock<std::shared_mutex> lock(set->suffix_memo_lock);
+        auto it = set->suffix_memo.find(key);
+        if (it != set->suffix_memo.end())
+            return it->second;
+    }
+
+    SuffixMemo memo{-1, nullptr};
+    for (std::size_t i = 0; i < set->caches.size(); ++i)
+    {
+        const char* suffix_pos = nullptr;
+        const char* type = mime_cache_lookup_suffix(set->caches[i], key.c_str(), &suffix_pos);
+        if (type)
+        {
+            memo.cache = i;
+            memo.type = mime_type_intern(type);
+            break;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(set->suffix_memo_lock);
+    if (set->suffix_memo.size() >= SUFFIX_MEMO_MAX)
+        suffix_memo_evict(set);
+    set->suffix_memo.emplace(key, memo);
+    return memo;
+}
+
+static const char*
+mime_type_get_by_filename_set(MimeCacheSet* set, const char* filename)
+{
+    const char* type = nullptr;
+
+    /* caches are tried in order, and within a cache a literal name wins over a suffix */
+    SuffixMemo suffix = suffix_memo_lookup(set, filename);
+    std::size_t n_literal_caches = suffix.cache == -1 ? set->caches.size() : suffix.cache + 1;
+    for (std::size_t i = 0; !type && i < n_literal_caches; ++i)
+        type = mime_cache_lookup_literal(set->caches[i], filename);
+    if (G_LIKELY(!type))
+        type = suffix.type;
+    else
+        type = mime_type_intern(type);
 
     if (G_UNLIKELY(!type)) /* glob matching */
     {
         int max_glob_len = 0;
         int glob_len = 0;
-        for (unsigned int i = 0; !type && i < n_caches; ++i)
+        for (std::size_t i = 0; !type && i < set->caches.size(); ++i)
         {
-            cache = caches[i];
             const char* matched_type;
-            matched_type = mime_cache_lookup_glob(cache, filename, &glob_len);
+            matched_type = mime_cache_lookup_glob(set->caches[i], filename, &glob_len);
             /* according to the mime.cache 1.0 spec, we should use the longest glob matched. */
             if (matched_type && glob_len > max_glob_len)
             {
@@ -128,11 +290,29 @@ mime_type_get_by_filename(const char* filename, struct stat* statbuf)
                 max_glob_len = glob_len;
             }
         }
+        type = mime_type_intern(type);
     }
 
     return type && *type ? type : XDG_MIME_TYPE_UNKNOWN;
 }
 
+/*
+ * Get mime-type of the specified file (quick, but less accurate):
+ * Mime-type of the file is determined by cheking the filename only.
+ * If statbuf != nullptr, it will be used to determine if the file is a directory.
+ */
+const char*
+mime_type_get_by_filename(const char* filename, struct stat* statbuf)
+{
+    if (G_UNLIKELY(statbuf && S_ISDIR(statbuf->st_mode)))
+        return XDG_MIME_TYPE_DIRECTORY;
+
+    const std::shared_ptr<MimeCacheSet> set = mime_cache_set_get();
+    if (G_UNLIKELY(!set))
+        return XDG_MIME_TYPE_UNKNOWN;
+    return mime_type_get_by_filename_set(set.get(), filename);
+}
+
 /*
  * Get mime-type info of the specified file (slow, but more accurate):
  * To determine the mime-type of the file, mime_type_get_by_filename() is
@@ -149,22 +329,38 @@ mime_type_get_by_filename(const char* filename, struct stat* statbuf)
 const char*
 mime_type_get_by_file(const char* filepath, struct stat* statbuf, const char* basename)
 {
-    const char* type;
-    struct stat _statbuf;
+    return mime_type_get_by_file_text(filepath, statbuf, basename, nullptr);
+}
+
+/* The part of mime_type_get_by_file_text() decided without reading the file,
+ * mime_type_get_by_file_no_content() uses it too so both always agree.
+ * Returns nullptr if the content has to be checked, *statbuf and set are
+ * then the stat of the file and the caches to check it with. */
+static const char*
+mime_type_get_by_file_name_part(const char* filepath, struct stat** statbuf,
+                                struct stat* own_statbuf, const char* basename,
+                                std::shared_ptr<MimeCacheSet>& set, MimeTextCheck* text)
+{
+    if (text)
+        *text = MIME_TEXT_UNCHECKED;
 
-    /* IMPORTANT!! vfs-file-info.c:vfs_file_info_reload_mime_type() depends
-     * on this function only using the st_mode from statbuf.
-     * Also see vfs-dir.c:vfs_dir_load_thread */
-    if (statbuf == nullptr || G_UNLIKELY(S_ISLNK(statbuf->st_mode)))
+    /* IMPORTANT!! vfs-dir.c:vfs_dir_retype_thread() depends on this
+     * function only using the st_mode and st_size from statbuf. */
+    if (*statbuf == nullptr || G_UNLIKELY(S_ISLNK((*statbuf)->st_mode)))
     {
-        statbuf = &_statbuf;
-        if (stat(filepath, statbuf) == -1)
+        *statbuf = own_statbuf;
+        if (stat(filepath, *statbuf) == -1)
             return XDG_MIME_TYPE_UNKNOWN;
     }
 
-    if (S_ISDIR(statbuf->st_mode))
+    if (S_ISDIR((*statbuf)->st_mode))
         return XDG_MIME_TYPE_DIRECTORY;
 
+    // the same caches for the name and the content, even if reloaded meanwhile
+    set = mime_cache_set_get();
+    if (G_UNLIKELY(!set))
+        return XDG_MIME_TYPE_UNKNOWN;
+
     if (basename == nullptr)
     {
         basename = g_utf8_strrchr(filepath, -1, '/');
@@ -174,89 +370,98 @@ mime_type_get_by_file(const char* filepath, struct stat* statbuf, const char* ba
             basename = filepath;
     }
 
-    if (G_LIKELY(basename))
-    {
-        type = mime_type_get_by_filename(basename, statbuf);
-        if (G_LIKELY(strcmp(type, XDG_MIME_TYPE_UNKNOWN)))
-            return type;
-        type = nullptr;
-    }
+    const char* type = mime_type_get_by_filename_set(set.get(), basename);
+    if (G_LIKELY(strcmp(type, XDG_MIME_TYPE_UNKNOWN)))
+        return type;
 
     // sfm added check for reg or link due to hangs on fifo and chr dev
-    if (G_LIKELY(statbuf->st_size > 0 && (S_ISREG(statbuf->st_mode) || S_ISLNK(statbuf->st_mode))))
-    {
-        int fd = -1;
-        char* data;
+    if (G_LIKELY((*statbuf)->st_size > 0 &&
+                 (S_ISREG((*statbuf)->st_mode) || S_ISLNK((*statbuf)->st_mode))))
+        return nullptr;
 
-        /* Open the file and map it into memory */
-        fd = open(filepath, O_RDONLY, 0);
-        if (fd != -1)
-        {
-            int len =
-                mime_cache_max_extent < statbuf->st_size ? mime_cache_max_extent : statbuf->st_size;
-#ifdef HAVE_MMAP
-            data = (char*)mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0);
-#else
-            /*
-             * FIXME: Can g_alloca() be used here? It's very fast, but is it safe?
-             * Actually, we can allocate a block of memory with the size of mime_cache_max_extent,
-             * then we don't need to  do dynamic allocation/free every time, but multi-threading
-             * will be a nightmare, so...
-             */
-            /* try to lock the common buffer */
-            if (G_LIKELY(G_TRYLOCK(mime_magic_buf)))
-                data = mime_magic_buf;
-            else /* the buffer is in use, allocate new one */
-                data = static_cast<char*>(g_malloc(len));
-
-            len = read(fd, data, len);
-
-            if (G_UNLIKELY(len == -1))
-            {
-                if (G_LIKELY(data == mime_magic_buf))
-                    G_UNLOCK(mime_magic_buf);
-                else
-                    g_free(data);
-                data = (char*)-1;
-            }
-#endif
-            if (data != (char*)-1)
-            {
-                for (unsigned int i = 0; !type && i < n_caches; ++i)
-                    type = mime_cache_lookup_magic(caches[i], data, len);
+    /* empty file can be viewed as text file */
+    if (text && S_ISREG((*statbuf)->st_mode))
+        *text = MIME_TEXT_PLAIN;
+    return XDG_MIME_TYPE_PLAIN_TEXT;
+}
+
+const char*
+mime_type_get_by_file_text(const char* filepath, struct stat* statbuf, const char* basename,
+                           MimeTextCheck* text)
+{
+    struct stat _statbuf;
+    std::shared_ptr<MimeCacheSet> set;
 
-                /* Check for executable file */
-                if (!type && have_x_access(filepath))
-                    type = XDG_MIME_TYPE_EXECUTABLE;
+    const char* name_type =
+        mime_type_get_by_file_name_part(filepath, &statbuf, &_statbuf, basename, set, text);
+    if (name_type)
+        return name_type;
 
-                /* fallback: check for plain text */
-                if (!type)
-                {
-                    if (mime_type_is_data_plain_text(data,
-                                                     len > TEXT_MAX_EXTENT ? TEXT_MAX_EXTENT : len))
-                        type = XDG_MIME_TYPE_PLAIN_TEXT;
-                }
+    const char* type = nullptr;
+    int fd = -1;
+    char* data;
 
+    /* Open the file and map it into memory */
+    fd = open(filepath, O_RDONLY, 0);
+    if (fd != -1)
+    {
+        int len = set->max_extent < statbuf->st_size ? set->max_extent : statbuf->st_size;
 #ifdef HAVE_MMAP
-                munmap((char*)data, len);
+        data = (char*)mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0);
 #else
-                if (G_LIKELY(data == mime_magic_buf))
-                    G_UNLOCK(mime_magic_buf); /* unlock the common buffer */
-                else                          /* we use our own buffer */
-                    g_free(data);
+        /* grows once per thread, and again only if a reloaded cache needs more */
+        if (G_UNLIKELY(mime_magic_buf.size() < static_cast<std::size_t>(len)))
+            mime_magic_buf.resize(len);
+        data = mime_magic_buf.data();
+
+        len = read(fd, data, len);
+
+        if (G_UNLIKELY(len == -1))
+            data = (char*)-1;
 #endif
+        if (data != (char*)-1)
+        {
+            for (std::size_t i = 0; !type && i < set->caches.size(); ++i)
+                type = mime_cache_lookup_magic(set->caches[i], data, len);
+            type = mime_type_intern(type);
+
+            /* Check for executable file */
+            if (!type && have_x_access(filepath))
+                type = XDG_MIME_TYPE_EXECUTABLE;
+
+            /* fallback: check for plain text, the bytes are at hand anyway
+             * so the result is kept for mime_type_is_text_data() */
+            const int text_len = len > TEXT_MAX_EXTENT ? TEXT_MAX_EXTENT : len;
+            // after a short read mime_type_is_text_file() could still decide otherwise
+            const bool text_complete =
+                text_len == std::min<off_t>(statbuf->st_size, TEXT_MAX_EXTENT);
+            if (!type || (text && text_complete))
+            {
+                const bool is_text = mime_type_is_data_plain_text(data, text_len);
+                if (!type && is_text)
+                    type = XDG_MIME_TYPE_PLAIN_TEXT;
+                if (text && text_complete)
+                    *text = is_text ? MIME_TEXT_PLAIN : MIME_TEXT_BINARY;
             }
-            close(fd);
+
+#ifdef HAVE_MMAP
+            munmap((char*)data, len);
+#endif
         }
-    }
-    else
-    {
-        /* empty file can be viewed as text file */
-        type = XDG_MIME_TYPE_PLAIN_TEXT;
+        close(fd);
     }
     return type && *type ? type : XDG_MIME_TYPE_UNKNOWN;
 }
 
+const char*
+mime_type_get_by_file_no_content(const char* filepath, struct stat* statbuf, const char* basename)
+{
+    struct stat _statbuf;
+    std::shared_ptr<MimeCacheSet> set;
+
+    return mime_type_get_by_file_name_part(filepath, &statbuf, &_statbuf, basename, set, nullptr);
+}
+
 static char*
 parse_xml_icon(const char* buf, std::size_t len, bool is_local)
 { // Note: This function modifies contents of buf
@@ -348,8 +553,9 @@ parse_xml_desc(const char* buf, std::size_t len, const char* locale)
     return g_strndup(eng_comment, eng_comment_len);
 }
 
-static char*
-_mime_type_get_desc_icon(const char* file_path, const char* locale, bool is_local, char** icon_name)
+char*
+mime_type_get_desc_icon_from_file(const char* file_path, const char* locale, bool is_local,
+                                  char** icon_name)
 {
     struct stat statbuf; // skip stat
 
@@ -420,6 +626,10 @@ mime_type_get_desc_icon(const char* type, const char* locale, char** icon_name)
     char* desc;
     char file_path[256];
 
+    /* the index answers without reading any xml once it is loaded */
+    if (G_LIKELY(mime_desc_index_lookup(type, locale, &desc, icon_name)))
+        return desc;
+
     /*  //sfm 0.7.7+ FIXED:
      * According to specs on freedesktop.org, user_data_dir has
      * higher priority than system_data_dirs, but in most cases, there was
@@ -431,7 +641,7 @@ mime_type_get_desc_icon(const char* type, const char* locale, char** icon_name)
     g_snprintf(file_path, 256, "%s/mime/%s.xml", vfs_user_data_dir(), type);
     if (faccessat(0, file_path, F_OK, AT_EACCESS) != -1)
     {
-        desc = _mime_type_get_desc_icon(file_path, locale, true, icon_name);
+        desc = mime_type_get_desc_icon_from_file(file_path, locale, true, icon_name);
         if (desc)
             return desc;
     }
@@ -444,7 +654,7 @@ mime_type_get_desc_icon(const char* type, const char* locale, char** icon_name)
         g_snprintf(file_path, 256, "%s/mime/%s.xml", *dir, type);
         if (faccessat(0, file_path, F_OK, AT_EACCESS) != -1)
         {
-            desc = _mime_type_get_desc_icon(file_path, locale, false, icon_name);
+            desc = mime_type_get_desc_icon_from_file(file_path, locale, false, icon_name);
             if (G_LIKELY(desc))
                 return desc;
         }
@@ -455,105 +665,78 @@ mime_type_get_desc_icon(const char* type, const char* locale, char** icon_name)
 void
 mime_type_finalize()
 {
-    mime_cache_free_all();
+    mime_desc_index_clean();
+    std::lock_guard<std::mutex> lock(cache_set_lock);
+    cache_set.reset();
 }
 
 void
 mime_type_init()
 {
-    mime_cache_load_all();
+    mime_type_reload();
+    mime_desc_index_load();
     //    table = g_hash_table_new_full( g_str_hash, g_str_equal, g_free,
     //    (GDestroyNotify)mime_type_unref );
 }
 
-/* load all mime.cache files on the system,
- * including /usr/share/mime/mime.cache,
- * /usr/local/share/mime/mime.cache,
- * and $HOME/.local/share/mime/mime.cache. */
-static void
-mime_cache_load_all()
-{
-    const char filename[] = "/mime/mime.cache";
-
-    const char* const* dirs = vfs_system_data_dir();
-    n_caches = g_strv_length((char**)dirs) + 1;
-    caches = (MimeCache**)g_slice_alloc(n_caches * sizeof(MimeCache*));
-
-    char* path = g_build_filename(vfs_user_data_dir(), filename, nullptr);
-    caches[0] = mime_cache_new(path);
-    g_free(path);
-    if (caches[0]->magic_max_extent > mime_cache_max_extent)
-        mime_cache_max_extent = caches[0]->magic_max_extent;
-
-    for (unsigned int i = 1; i < n_caches; ++i)
-    {
-        path = g_build_filename(dirs[i - 1], filename, nullptr);
-        caches[i] = mime_cache_new(path);
-        g_free(path);
-        if (caches[i]->magic_max_extent > mime_cache_max_extent)
-            mime_cache_max_extent = caches[i]->magic_max_extent;
-    }
-    mime_magic_buf = static_cast<char*>(g_malloc(mime_cache_max_extent));
-    return;
-}
-
-/* free all mime.cache files on the system */
-static void
-mime_cache_free_all()
+void
+mime_type_reload()
 {
-    mime_cache_foreach((GFunc)mime_cache_free, nullptr);
-    g_slice_free1(n_caches * sizeof(MimeCache*), caches);
-    n_caches = 0;
-    caches = nullptr;
-    mime_cache_max_extent = 0;
-
-    g_free(mime_magic_buf);
-    mime_magic_buf = nullptr;
+    const std::shared_ptr<MimeCacheSet> set = mime_cache_set_load();
+    std::lock_guard<std::mutex> lock(cache_set_lock);
+    cache_set = set;
 }
 
-/* Iterate through all mime caches */
-static void
-mime_cache_foreach(GFunc func, void* user_data)
+const std::string
+mime_type_get_cache_stamp()
 {
-    for (unsigned int i = 0; i < n_caches; ++i)
-        func(caches[i], user_data);
+    const std::shared_ptr<MimeCacheSet> set = mime_cache_set_get();
+    return set ? set->stamp : std::string();
 }
 
-bool
-mime_cache_reload(MimeCache* cache)
+const std::vector<std::string>
+mime_type_get_cache_files()
 {
-    bool ret = mime_cache_load(cache, cache->file_path);
-    /* recalculate max magic extent */
-    for (unsigned int i = 0; i < n_caches; ++i)
-    {
-        if (caches[i]->magic_max_extent > mime_cache_max_extent)
-            mime_cache_max_extent = caches[i]->magic_max_extent;
-    }
-
-    G_LOCK(mime_magic_buf);
-
-    mime_magic_buf = (char*)g_realloc(mime_magic_buf, mime_cache_max_extent);
-
-    G_UNLOCK(mime_magic_buf);
-
-    return ret;
+    std::vector<std::string> files;
+    files.emplace_back(vfs_build_path(vfs_user_data_dir(), "mime", "mime.cache"));
+    for (const char* const* dir = vfs_system_data_dir(); *dir; ++dir)
+        files.emplace_back(vfs_build_path(*dir, "mime", "mime.cache"));
+    return files;
 }
 
+/* memchr() is vectorized by the C library, a byte at a time loop is not */
 static bool
 mime_type_is_data_plain_text(const char* data, int len)
 {
     if (G_LIKELY(len >= 0 && data))
-    {
-        for (int i = 0; i < len; ++i)
-        {
-            if (data[i] == '\0')
-                return false;
-        }
-        return true;
-    }
+        return len == 0 || !memchr(data, '\0', len);
     return false;
 }
 
+/* the checks of mime_type_is_text_file() that only need the type,
+ * returns -1 if the content decides */
+static int
+mime_type_is_text_type(const char* mime_type)
+{
+    if (!strcmp(mime_type, "application/pdf"))
+        // seems to think this is XDG_MIME_TYPE_PLAIN_TEXT
+        return 0;
+    if (mime_type_is_subclass(mime_type, XDG_MIME_TYPE_PLAIN_TEXT))
+        return 1;
+    if (!g_str_has_prefix(mime_type, "text/") && !g_str_has_prefix(mime_type, "application/"))
+        return 0;
+    return -1;
+}
+
+bool
+mime_type_is_text_data(const char* mime_type, MimeTextCheck text)
+{
+    int ret = mime_type ? mime_type_is_text_type(mime_type) : -1;
+    if (ret != -1)
+        return ret;
+    return text == MIME_TEXT_PLAIN;
+}
+
 bool
 mime_type_is_text_file(const char* file_path, const char* mime_type)
 {
@@ -562,13 +745,9 @@ mime_type_is_text_file(const char* file_path, const char* mime_type)
 
     if (mime_type)
     {
-        if (!strcmp(mime_type, "application/pdf"))
-            // seems to think this is XDG_MIME_TYPE_PLAIN_TEXT
-            return false;
-        if (mime_type_is_subclass(mime_type, XDG_MIME_TYPE_PLAIN_TEXT))
-            return true;
-        if (!g_str_has_prefix(mime_type, "text/") && !g_str_has_prefix(mime_type, "application/"))
-            return false;
+        int type_ret = mime_type_is_text_type(mime_type);
+        if (type_ret != -1)
+            return type_ret;
     }
 
     if (!file_path)
@@ -635,28 +814,36 @@ mime_type_is_subclass(const char* type, const char* parent)
     if (G_UNLIKELY(!strcmp(type, parent)))
         return true;
 
-    for (unsigned int i = 0; i < n_caches; ++i)
+    const std::shared_ptr<MimeCacheSet> set = mime_cache_set_get();
+    if (G_UNLIKELY(!set))
+        return false;
+    for (MimeCache* cache: set->caches)
     {
-        const char** parents = mime_cache_lookup_parents(caches[i], type);
+        const char** parents = mime_cache_lookup_parents(cache, type);
         if (parents)
         {
-            const char** p;
-            for (p = parents; *p; ++p)
-            {
-                if (!strcmp(parent, *p))
-                    return true;
-            }
+            bool found = false;
+            for (const char** p = parents; !found && *p; ++p)
+                found = !strcmp(parent, *p);
+            g_free(parents);
+            if (found)
+                return true;
         }
     }
     return false;
 }
 
 /*
- * Get mime caches
+ * Fingerprint of the magic rules of all caches
  */
-MimeCache**
-mime_type_get_caches(int* n)
+uint64_t
+mime_type_get_magic_hash()
 {
-    *n = n_caches;
-    return caches;
+    const std::shared_ptr<MimeCacheSet> set = mime_cache_set_get();
+    if (G_UNLIKELY(!set))
+        return 0;
+    uint64_t hash = set->caches.size();
+    for (MimeCache* cache: set->caches)
+        hash = hash * 31 + cache->magic_hash;
+    return hash;
 }
@@ -21,6 +21,9 @@
 
 #pragma once
 
+#include <string>
+#include <vector>
+
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <glib.h>
@@ -43,6 +46,17 @@ void mime_type_init();
 /* Finalize the library and free related resources */
 void mime_type_finalize();
 
+/* Load all mime.cache files again, lookups running meanwhile finish
+ * with the caches they started with */
+void mime_type_reload();
+
+/* The mime.cache files that are loaded, can be used to monitor them */
+const std::vector<std::string> mime_type_get_cache_files();
+
+/* Path, mtime and size of each loaded mime.cache, it changes with every
+ * database update, so results saved along with it can be checked later */
+const std::string mime_type_get_cache_stamp();
+
 /* Get additional info of the specified mime-type */
 // MimeInfo* mime_type_get_by_type( const char* type_name );
 
@@ -69,8 +83,34 @@ const char* mime_type_get_by_filename(const char* filename, struct stat* statbuf
  */
 const char* mime_type_get_by_file(const char* filepath, struct stat* statbuf, const char* basename);
 
+/* what the content read by mime_type_get_by_file_text() looked like */
+enum MimeTextCheck : unsigned char
+{
+    MIME_TEXT_UNCHECKED, /* the content was not read */
+    MIME_TEXT_BINARY,
+    MIME_TEXT_PLAIN
+};
+
+/*
+ * Same as mime_type_get_by_file(), and if the content has to be read, it is
+ * also checked for text the same way mime_type_is_text_file() does.
+ */
+const char* mime_type_get_by_file_text(const char* filepath, struct stat* statbuf,
+                                       const char* basename, MimeTextCheck* text);
+
+/*
+ * Same as mime_type_get_by_file(), but never reads the file content.
+ * Returns nullptr if only checking the content could tell the mime-type.
+ */
+const char* mime_type_get_by_file_no_content(const char* filepath, struct stat* statbuf,
+                                             const char* basename);
+
 bool mime_type_is_text_file(const char* file_path, const char* mime_type);
 
+/* Same as mime_type_is_text_file(), with the content already checked
+ * by mime_type_get_by_file_text() */
+bool mime_type_is_text_data(const char* mime_type, MimeTextCheck text);
+
 bool mime_type_is_executable_file(const char* file_path, const char* mime_type);
 
 /* Check if the specified mime_type is the subclass of the specified parent type */
@@ -82,6 +122,11 @@ bool mime_type_is_executable_file(const char* file_path, const char* mime_type);
  * The icon_name will only be set if points to nullptr, and must be freed. */
 char* mime_type_get_desc_icon(const char* type, const char* locale, char** icon_name);
 
+/* Same as mime_type_get_desc_icon(), but parses the given xml file.
+ * The icon is only taken from user (is_local) xml files. */
+char* mime_type_get_desc_icon_from_file(const char* file_path, const char* locale, bool is_local,
+                                        char** icon_name);
+
 /*
  * Iterate through all mime caches
  * Can be used to hook file alteration monitor for the cache files to handle reloading.
@@ -89,9 +134,7 @@ char* mime_type_get_desc_icon(const char* type, const char* locale, char** icon_
 // void mime_cache_foreach(GFunc func, void* user_data);
 
 /*
- * Get mime caches
+ * Fingerprint of the magic rules of all caches. Unchanged after a reload
+ * means every mime-type detected from file content is still valid.
  */
-MimeCache** mime_type_get_caches(int* n);
-
-/* max magic extent of all caches */
-extern uint32_t mime_cache_max_extent;
+uint64_t mime_type_get_magic_hash();
@@ -19,6 +19,8 @@
 #include "ptk/ptk-file-menu.hxx"
 #include "ptk/ptk-file-task.hxx"
 
+#include "vfs/vfs-dir.hxx"
+
 #include "ptk/ptk-dir-tree-view.hxx"
 
 static GQuark dir_tree_view_data = 0;
@@ -36,6 +38,9 @@ static bool on_dir_tree_view_button_press(GtkWidget* view, GdkEventButton* evt,
 
 static bool on_dir_tree_view_key_press(GtkWidget* view, GdkEventKey* evt, PtkFileBrowser* browser);
 
+static bool on_dir_tree_view_motion_notify(GtkWidget* view, GdkEventMotion* evt,
+                                           PtkFileBrowser* browser);
+
 static bool sel_func(GtkTreeSelection* selection, GtkTreeModel* model, GtkTreePath* path,
                      bool path_currently_selected, void* data);
 
@@ -178,6 +183,11 @@ ptk_dir_tree_view_new(PtkFileBrowser* browser, bool show_hidden)
                      G_CALLBACK(on_dir_tree_view_key_press),
                      browser);
 
+    g_signal_connect(dir_tree_view,
+                     "motion-notify-event",
+                     G_CALLBACK(on_dir_tree_view_motion_notify),
+                     browser);
+
     // MOD drag n drop
     g_signal_connect((void*)dir_tree_view,
                      "drag-data-received",
@@ -453,6 +463,40 @@ on_dir_tree_view_button_press(GtkWidget* view, GdkEventButton* evt, PtkFileBrows
     return false;
 }
 
+static bool
+on_dir_tree_view_motion_notify(GtkWidget* view, GdkEventMotion* evt, PtkFileBrowser* browser)
+{
+    (void)browser;
+    GtkTreePath* tree_path;
+    GtkTreeIter it;
+
+    if (evt->window != gtk_tree_view_get_bin_window(GTK_TREE_VIEW(view)))
+        return false;
+
+    // a hovered dir is likely to be clicked next, start loading it
+    GtkTreeModel* model = gtk_tree_view_get_model(GTK_TREE_VIEW(view));
+    if (gtk_tree_view_get_path_at_pos(GTK_TREE_VIEW(view),
+                                      evt->x,
+                                      evt->y,
+                                      &tree_path,
+                                      nullptr,
+                                      nullptr,
+                                      nullptr))
+    {
+        if (gtk_tree_model_get_iter(model, &it, tree_path))
+        {
+            char* dir_path = ptk_dir_view_get_dir_path(model, &it);
+            if (dir_path)
+            {
+                vfs_dir_prefetch(dir_path);
+                g_free(dir_path);
+            }
+        }
+        gtk_tree_path_free(tree_path);
+    }
+    return false;
+}
+
 static bool
 on_dir_tree_view_key_press(GtkWidget* view, GdkEventKey* evt, PtkFileBrowser* browser)
 {
@@ -3113,6 +3113,70 @@ on_folder_view_row_activated(GtkTreeView* tree_view, GtkTreePath* path, GtkTreeV
     ptk_file_browser_open_selected_files(file_browser);
 }
 
+/* start loading a dir the user is likely to open next */
+static void
+folder_view_prefetch(PtkFileBrowser* file_browser, VFSFileInfo* file)
+{
+    if (!vfs_file_info_is_dir(file))
+    {
+        vfs_dir_prefetch(nullptr);
+        return;
+    }
+    char* path = g_build_filename(ptk_file_browser_get_cwd(file_browser),
+                                  vfs_file_info_get_name(file),
+                                  nullptr);
+    vfs_dir_prefetch(path);
+    g_free(path);
+}
+
+static bool
+on_folder_view_motion_notify_event(GtkWidget* widget, GdkEventMotion* event,
+                                   PtkFileBrowser* file_browser)
+{
+    GtkTreeModel* model = nullptr;
+    GtkTreePath* tree_path = nullptr;
+
+    switch (file_browser->view_mode)
+    {
+        case PTK_FB_ICON_VIEW:
+        case PTK_FB_COMPACT_VIEW:
+            tree_path = exo_icon_view_get_path_at_pos(EXO_ICON_VIEW(widget), event->x, event->y);
+            model = exo_icon_view_get_model(EXO_ICON_VIEW(widget));
+            break;
+        case PTK_FB_LIST_VIEW:
+            if (event->window != gtk_tree_view_get_bin_window(GTK_TREE_VIEW(widget)))
+                break;
+            model = gtk_tree_view_get_model(GTK_TREE_VIEW(widget));
+            gtk_tree_view_get_path_at_pos(GTK_TREE_VIEW(widget),
+                                          event->x,
+                                          event->y,
+                                          &tree_path,
+                                          nullptr,
+                                          nullptr,
+                                          nullptr);
+            break;
+        default:
+            break;
+    }
+
+    // only hovering a dir starts a prefetch, moving over other rows keeps the current one
+    GtkTreeIter it;
+    if (tree_path && gtk_tree_model_get_iter(model, &it, tree_path))
+    {
+        VFSFileInfo* file;
+        gtk_tree_model_get(model, &it, COL_FILE_INFO, &file, -1);
+        if (file)
+        {
+            if (vfs_file_info_is_dir(file))
+                folder_view_prefetch(file_browser, file);
+            vfs_file_info_unref(file);
+        }
+    }
+    if (tree_path)
+        gtk_tree_path_free(tree_path);
+    return false;
+}
+
 static bool
 on_folder_view_item_sel_change_idle(PtkFileBrowser* file_browser)
 {
@@ -3125,6 +3189,7 @@ on_folder_view_item_sel_change_idle(PtkFileBrowser* file_browser)
     GtkTreeModel* model;
     GList* sel_files = folder_view_get_selected_items(file_browser, &model);
 
+    bool sel_dir = false;
     GList* sel;
     for (sel = sel_files; sel; sel = g_list_next(sel))
     {
@@ -3136,11 +3201,19 @@ on_folder_view_item_sel_change_idle(PtkFileBrowser* file_browser)
             if (file)
             {
                 file_browser->sel_size += vfs_file_info_get_size(file);
+                // a single selected dir is likely to be opened next
+                if (!sel_files->next)
+                {
+                    folder_view_prefetch(file_browser, file);
+                    sel_dir = true;
+                }
                 vfs_file_info_unref(file);
             }
             ++file_browser->n_sel_files;
         }
     }
+    if (!sel_dir)
+        vfs_dir_prefetch(nullptr);
 
     g_list_foreach(sel_files, (GFunc)gtk_tree_path_free, nullptr);
     g_list_free(sel_files);
@@ -3929,6 +4002,11 @@ create_folder_view(PtkFileBrowser* file_browser, PtkFBViewMode view_mode)
                      G_CALLBACK(on_folder_view_popup_menu),
                      file_browser);
 
+    g_signal_connect((void*)folder_view,
+                     "motion-notify-event",
+                     G_CALLBACK(on_folder_view_motion_notify_event),
+                     file_browser);
+
     /* init drag & drop support */
 
     g_signal_connect((void*)folder_view,
@@ -695,9 +695,11 @@ ptk_file_list_compare(const void* a, const void* b, void* user_data)
 
         // alphanumeric
         if (list->sort_case)
-            result = AlphaNum::alphanum_comp(file_a->collate_key, file_b->collate_key);
+            result = AlphaNum::alphanum_comp(vfs_file_info_get_collate_key(file_a),
+                                             vfs_file_info_get_collate_key(file_b));
         else
-            result = AlphaNum::alphanum_comp(file_a->collate_icase_key, file_b->collate_icase_key);
+            result = AlphaNum::alphanum_comp(vfs_file_info_get_collate_icase_key(file_a),
+                                             vfs_file_info_get_collate_icase_key(file_b));
     }
 #if 0
     // TODO support both alphanum and natural sort
@@ -705,9 +707,11 @@ ptk_file_list_compare(const void* a, const void* b, void* user_data)
     {
         // natural
         if (list->sort_case)
-            result = strcmp(file_a->collate_key, file_b->collate_key);
+            result = strcmp(vfs_file_info_get_collate_key(file_a),
+                            vfs_file_info_get_collate_key(file_b));
         else
-            result = strcmp(file_a->collate_icase_key, file_b->collate_icase_key);
+            result = strcmp(vfs_file_info_get_collate_icase_key(file_a),
+                            vfs_file_info_get_collate_icase_key(file_b));
     }
 #endif
     else
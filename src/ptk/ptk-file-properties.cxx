@@ -15,13 +15,11 @@
 
 #include "ptk/ptk-file-properties.hxx"
 
-#include <pwd.h>
-#include <grp.h>
-
 #include "ptk/ptk-file-task.hxx"
 #include "ptk/ptk-utils.hxx"
 
 #include "vfs/vfs-app-desktop.hxx"
+#include "vfs/vfs-owner-cache.hxx"
 
 #include "ptk/ptk-app-chooser.hxx"
 #include "utils.hxx"
@@ -642,58 +640,6 @@ file_properties_dlg_new(GtkWindow* parent, const char* dir_path, GList* sel_file
     return dlg;
 }
 
-static uid_t
-uid_from_name(const char* user_name)
-{
-    uid_t uid;
-
-    struct passwd* pw;
-    pw = getpwnam(user_name);
-    if (pw)
-    {
-        uid = pw->pw_uid;
-    }
-    else
-    {
-        uid = 0;
-        const char* p;
-        for (p = user_name; *p; ++p)
-        {
-            if (!g_ascii_isdigit(*p))
-                return -1;
-            uid *= 10;
-            uid += (*p - '0');
-        }
-    }
-    return uid;
-}
-
-static gid_t
-gid_from_name(const char* group_name)
-{
-    gid_t gid;
-
-    struct group* grp;
-    grp = getgrnam(group_name);
-    if (grp)
-    {
-        gid = grp->gr_gid;
-    }
-    else
-    {
-        gid = 0;
-        const char* p;
-        for (p = group_name; *p; ++p)
-        {
-            if (!g_ascii_isdigit(*p))
-                return -1;
-            gid *= 10;
-            gid += (*p - '0');
-        }
-    }
-    return gid;
-}
-
 static void
 on_dlg_response(GtkDialog* dialog, int response_id, void* user_data)
 {
@@ -816,7 +762,7 @@ on_dlg_response(GtkDialog* dialog, int response_id, void* user_data)
             if (owner_name && *owner_name &&
                 (!data->owner_name || strcmp(owner_name, data->owner_name)))
             {
-                uid = uid_from_name(owner_name);
+                uid = vfs_owner_cache_uid(owner_name);
                 if (!uid)
                 {
                     ptk_show_error(GTK_WINDOW(dialog), "Error", "Invalid User");
@@ -827,7 +773,7 @@ on_dlg_response(GtkDialog* dialog, int response_id, void* user_data)
             if (group_name && *group_name &&
                 (!data->group_name || strcmp(group_name, data->group_name)))
             {
-                gid = gid_from_name(group_name);
+                gid = vfs_owner_cache_gid(group_name);
                 if (!gid)
                 {
                     ptk_show_error(GTK_WINDOW(dialog), "Error", "Invalid Group");
@@ -11,6 +11,8 @@
 
 #include <string>
 #include <filesystem>
+#include <unordered_map>
+#include <vector>
 
 #include <iostream>
 #include <fstream>
@@ -1002,39 +1004,90 @@ ptk_handler_values_in_list(const char* list, GSList* values, char** msg)
     return ret;
 }
 
-static bool
-value_in_list(const char* list, const char* value)
-{ // this function must be FAST - is run multiple times on menu popup
-    char* ptr;
-    char* delim;
-    char ch;
+/* Patterns of the handlers of a mode, compiled when first needed after the
+ * handlers were changed. Literal mime types and "*.ext" filename patterns
+ * are looked up by key, any other pattern still goes through fnmatch. */
+struct HandlerIndex
+{
+    bool valid{false};
+    std::vector<XSet*> handlers; // in list order
+    std::unordered_map<std::string, std::vector<unsigned int>> mime_types;
+    std::unordered_map<std::string, std::vector<unsigned int>> suffixes; // ".tar.gz"
+    std::vector<std::pair<std::string, unsigned int>> mime_globs;
+    std::vector<std::pair<std::string, unsigned int>> path_globs;
+};
+
+static HandlerIndex handler_index[G_N_ELEMENTS(handler_conf_xset)];
+
+static void
+handler_index_invalidate()
+{
+    for (HandlerIndex& index: handler_index)
+        index.valid = false;
+}
 
-    // value in space-separated list with wildcards?
-    if (value && (ptr = (char*)list) && ptr[0])
+static void
+handler_index_compile(HandlerIndex& index, const char* list, unsigned int handler, bool is_path)
+{ // list is space-separated, with wildcards
+    if (!(list && list[0]))
+        return;
+
+    char** patterns = g_strsplit(list, " ", -1);
+    for (int i = 0; patterns[i]; i++)
     {
-        while (true)
-        {
-            while (ptr[0] == ' ')
-                ptr++;
-            if (!ptr[0])
-                break;
-            delim = ptr;
-            while (delim[0] != ' ' && delim[0])
-                delim++;
-            ch = delim[0];
-            delim[0] = '\0'; // set temporary end of string
-            if (fnmatch(ptr, value, 0) == 0)
-            {
-                delim[0] = ch; // restore
-                return true;
-            }
-            delim[0] = ch; // restore
-            if (ch == '\0')
-                break; // is end of string
-            ptr = delim + 1;
-        }
+        const char* pattern = patterns[i];
+        if (!pattern[0])
+            continue;
+        if (!is_path && !strpbrk(pattern, "*?[\\"))
+            index.mime_types[pattern].push_back(handler);
+        else if (is_path && pattern[0] == '*' && pattern[1] == '.' &&
+                 !strpbrk(pattern + 1, "*?[\\"))
+            index.suffixes[pattern + 1].push_back(handler);
+        else if (is_path)
+            index.path_globs.emplace_back(pattern, handler);
+        else
+            index.mime_globs.emplace_back(pattern, handler);
     }
-    return false;
+    g_strfreev(patterns);
+}
+
+static const HandlerIndex&
+handler_index_get(int mode)
+{
+    HandlerIndex& index = handler_index[mode];
+    if (index.valid)
+        return index;
+
+    index = HandlerIndex();
+    index.valid = true;
+
+    char* list = xset_get_s(handler_conf_xset[mode]);
+    if (!list)
+        return index;
+    char** names = g_strsplit(list, " ", -1);
+    for (int i = 0; names[i]; i++)
+    {
+        XSet* handler_set = names[i][0] ? xset_is(names[i]) : nullptr;
+        if (!handler_set)
+            continue;
+        const unsigned int handler = index.handlers.size();
+        index.handlers.push_back(handler_set);
+        handler_index_compile(index, handler_set->s, handler, false);
+        handler_index_compile(index, handler_set->x, handler, true);
+    }
+    g_strfreev(names);
+    return index;
+}
+
+static void
+handler_index_mark(const std::unordered_map<std::string, std::vector<unsigned int>>& map,
+                   const char* key, std::vector<bool>& matched)
+{
+    auto it = map.find(key);
+    if (it == map.end())
+        return;
+    for (unsigned int handler: it->second)
+        matched[handler] = true;
 }
 
 GSList*
@@ -1042,82 +1095,74 @@ ptk_handler_file_has_handlers(int mode, int cmd, const char* path, VFSMimeType*
                               bool test_cmd, bool multiple, bool enabled_only)
 { /* this function must be FAST - is run multiple times on menu popup
    * command must be non-empty if test_cmd */
-    const char* type;
-    char* delim;
-    char* ptr;
-    char* under_path;
     GSList* handlers = nullptr;
 
     if (!path && !mime_type)
         return nullptr;
-    // Fetching and validating MIME type if provided
-    if (mime_type)
-        type = (char*)vfs_mime_type_get_type(mime_type);
-    else
-        type = nullptr;
 
-    // replace spaces in path with underscores for matching
-    if (path && strchr(path, ' '))
+    const HandlerIndex& index = handler_index_get(mode);
+    if (index.handlers.empty())
+        return nullptr;
+
+    // handlers supporting type or path
+    std::vector<bool> matched(index.handlers.size(), false);
+    if (mime_type)
     {
-        std::string cleaned = ztd::replace(path, " ", "_");
-        under_path = g_strdup(cleaned.c_str());
+        const char* type = vfs_mime_type_get_type(mime_type);
+        handler_index_mark(index.mime_types, type, matched);
+        for (const auto& [glob, handler]: index.mime_globs)
+        {
+            if (!matched[handler] && fnmatch(glob.c_str(), type, 0) == 0)
+                matched[handler] = true;
+        }
     }
-    else
-        under_path = (char*)path;
-
-    // parsing handlers space-separated list
-    if ((ptr = xset_get_s(handler_conf_xset[mode])))
+    if (path)
     {
-        while (ptr[0])
+        // replace spaces in path with underscores for matching
+        const std::string under_path = ztd::replace(path, " ", "_");
+
+        // "*.ext" matches any path ending with a suffix starting at a dot
+        for (const char* dot = strchr(under_path.c_str(), '.'); dot; dot = strchr(dot + 1, '.'))
+            handler_index_mark(index.suffixes, dot, matched);
+        for (const auto& [glob, handler]: index.path_globs)
         {
-            while (ptr[0] == ' ')
-                ptr++;
-            if (!ptr[0])
-                break;
-            if ((delim = strchr(ptr, ' ')))
-                delim[0] = '\0'; // set temporary end of string
+            if (!matched[handler] && fnmatch(glob.c_str(), under_path.c_str(), 0) == 0)
+                matched[handler] = true;
+        }
+    }
 
-            // Fetching handler
-            XSet* handler_set = xset_is(ptr);
-            if (delim)
-                delim[0] = ' '; // remove temporary end of string
+    for (std::size_t i = 0; i < index.handlers.size(); i++)
+    {
+        XSet* handler_set = index.handlers[i];
+        if (!matched[i] || (enabled_only && handler_set->b != XSET_B_TRUE))
+            continue;
 
-            // handler supports type or path ?
-            if (handler_set && (!enabled_only || handler_set->b == XSET_B_TRUE) &&
-                (value_in_list(handler_set->s, type) || value_in_list(handler_set->x, under_path)))
+        // test command
+        if (test_cmd)
+        {
+            char* command;
+            char* err_msg = ptk_handler_load_script(mode, cmd, handler_set, nullptr, &command);
+            if (err_msg)
+            {
+                LOG_WARN("%s", err_msg);
+                g_free(err_msg);
+            }
+            else if (!ptk_handler_command_is_empty(command))
             {
-                // test command
-                if (test_cmd)
+                handlers = g_slist_prepend(handlers, handler_set);
+                if (!multiple)
                 {
-                    char* command;
-                    char* err_msg =
-                        ptk_handler_load_script(mode, cmd, handler_set, nullptr, &command);
-                    if (err_msg)
-                    {
-                        LOG_WARN("%s", err_msg);
-                        g_free(err_msg);
-                    }
-                    else if (!ptk_handler_command_is_empty(command))
-                    {
-                        handlers = g_slist_prepend(handlers, handler_set);
-                        if (!multiple)
-                        {
-                            g_free(command);
-                            break;
-                        }
-                    }
                     g_free(command);
-                }
-                else
-                {
-                    handlers = g_slist_prepend(handlers, handler_set);
-                    if (!multiple)
-                        break;
+                    break;
                 }
             }
-            if (!delim)
+            g_free(command);
+        }
+        else
+        {
+            handlers = g_slist_prepend(handlers, handler_set);
+            if (!multiple)
                 break;
-            ptr = delim + 1;
         }
     }
     return g_slist_reverse(handlers);
@@ -1226,6 +1271,7 @@ ptk_handler_add_defaults(int mode, bool overwrite, bool add_missing)
     // update handler list
     g_free(set_conf->s);
     set_conf->s = list;
+    handler_index_invalidate();
 }
 
 XSet*
@@ -1316,6 +1362,7 @@ ptk_handler_import(int mode, GtkWidget* handler_dlg, XSet* set)
         xset_set(handler_conf_xset[mode], "s", new_handlers_list);
         g_free(new_handlers_list);
     }
+    handler_index_invalidate();
 
     // have handler dialog open?
     HandlerData* hnd =
@@ -1614,6 +1661,7 @@ on_configure_drag_end(GtkWidget* widget, GdkDragContext* drag_context, HandlerDa
     // Saving the new archive handlers list
     xset_set(handler_conf_xset[hnd->mode], "s", archive_handlers);
     g_free(archive_handlers);
+    handler_index_invalidate();
 
     // Saving settings
     autosave_request();
@@ -2007,6 +2055,8 @@ on_configure_button_press(GtkButton* widget, HandlerData* hnd)
     }
 
 _clean_exit:
+    // a handler was added, saved, removed or moved
+    handler_index_invalidate();
     g_free(xset_name);
     g_free(handler_name_from_model);
 }
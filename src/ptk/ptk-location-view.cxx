@@ -22,6 +22,7 @@
 #include "ptk/ptk-handler.hxx"
 #include "main-window.hxx"
 
+#include "vfs/vfs-dir.hxx"
 #include "vfs/vfs-utils.hxx"
 #include "vfs/vfs-user-dir.hxx"
 
@@ -3562,10 +3563,9 @@ ptk_bookmark_view_chdir(GtkTreeView* view, PtkFileBrowser* file_browser, bool re
     return !!set;
 }
 
-char*
-ptk_bookmark_view_get_selected_dir(GtkTreeView* view)
+static char*
+get_bookmark_dir(XSet* set)
 {
-    XSet* set = get_selected_bookmark_set(view);
     if (set)
     {
         int cmd_type = set->x ? strtol(set->x, nullptr, 10) : -1;
@@ -3586,6 +3586,12 @@ ptk_bookmark_view_get_selected_dir(GtkTreeView* view)
     return nullptr;
 }
 
+char*
+ptk_bookmark_view_get_selected_dir(GtkTreeView* view)
+{
+    return get_bookmark_dir(get_selected_bookmark_set(view));
+}
+
 void
 ptk_bookmark_view_add_bookmark(GtkMenuItem* menuitem, PtkFileBrowser* file_browser, const char* url)
 { // adding from file browser - bookmarks may not be shown
@@ -3995,6 +4001,51 @@ on_bookmark_drag_end(GtkWidget* widget, GdkDragContext* drag_context, PtkFileBro
     g_free(inserted_name);
 }
 
+static void
+bookmark_prefetch(XSet* set)
+{
+    // a focused or hovered bookmark is likely to be opened next
+    char* url = get_bookmark_dir(set);
+    if (url)
+    {
+        vfs_dir_prefetch(url);
+        g_free(url);
+    }
+}
+
+static void
+on_bookmark_cursor_changed(GtkTreeView* view, PtkFileBrowser* file_browser)
+{
+    (void)file_browser;
+    bookmark_prefetch(get_selected_bookmark_set(view));
+}
+
+static bool
+on_bookmark_motion_notify_event(GtkTreeView* view, GdkEventMotion* evt,
+                                PtkFileBrowser* file_browser)
+{
+    (void)file_browser;
+    GtkTreePath* tree_path;
+
+    if (evt->window != gtk_tree_view_get_bin_window(view))
+        return false;
+
+    if (gtk_tree_view_get_path_at_pos(view, evt->x, evt->y, &tree_path, nullptr, nullptr, nullptr))
+    {
+        GtkTreeModel* model = gtk_tree_view_get_model(view);
+        GtkTreeIter it;
+        if (model && gtk_tree_model_get_iter(model, &it, tree_path))
+        {
+            char* name = nullptr;
+            gtk_tree_model_get(model, &it, COL_PATH, &name, -1);
+            bookmark_prefetch(xset_is(name));
+            g_free(name);
+        }
+        gtk_tree_path_free(tree_path);
+    }
+    return false;
+}
+
 static void
 on_bookmark_row_activated(GtkTreeView* view, GtkTreePath* path, GtkTreeViewColumn* column,
                           PtkFileBrowser* file_browser)
@@ -4255,6 +4306,11 @@ ptk_bookmark_view_new(PtkFileBrowser* file_browser)
                      G_CALLBACK(on_bookmark_key_press_event),
                      file_browser);
     g_signal_connect(view, "row-activated", G_CALLBACK(on_bookmark_row_activated), file_browser);
+    g_signal_connect(view, "cursor-changed", G_CALLBACK(on_bookmark_cursor_changed), file_browser);
+    g_signal_connect(view,
+                     "motion-notify-event",
+                     G_CALLBACK(on_bookmark_motion_notify_event),
+                     file_browser);
 
     file_browser->bookmark_button_press = false;
     file_browser->book_iter_inserted.stamp = 0;
@@ -16,6 +16,9 @@
 #include <iostream>
 #include <fstream>
 
+#include <condition_variable>
+#include <mutex>
+
 #include <unistd.h>
 
 #include <sys/stat.h>
@@ -318,6 +321,10 @@ parse_conf(std::string& etc_path, std::string& line)
         config_settings.font_view_compact = value.c_str();
     else if (ztd::same(token, "font_general"))
         config_settings.font_general = value.c_str();
+    else if (ztd::same(token, "dir_snapshot_cache"))
+        config_settings.dir_snapshot_cache = strtol(value.c_str(), nullptr, 10);
+    else if (ztd::same(token, "dir_cache_size"))
+        config_settings.dir_cache_size = strtol(value.c_str(), nullptr, 10);
 }
 
 void
@@ -400,23 +407,25 @@ load_settings(const char* config_dir)
     if (config_settings.git_backed_settings)
     {
         std::string git_path = g_build_filename(settings_config_dir.c_str(), ".git", nullptr);
+        // the history is not needed to load the session, do not wait for git
         if (!std::filesystem::exists(git_path))
         {
             command = fmt::format("{} -c \"cd {} && git init && "
                                   "git config commit.gpgsign false\"",
                                   BASHPATH,
                                   settings_config_dir);
-            g_spawn_command_line_sync(command.c_str(), nullptr, nullptr, nullptr, nullptr);
-            LOG_INFO("Initialized git repo at: {}", git_path);
+            g_spawn_command_line_async(command.c_str(), nullptr);
+            LOG_INFO("Initializing git repo at: {}", git_path);
         }
         else if (G_LIKELY(std::filesystem::exists(session)))
         {
+            // the session is replaced by rename, git never reads a partial file
             command = fmt::format("{} -c \"cd {} && git add session && "
                                   "git commit -m 'Session File' 1>/dev/null\"",
                                   BASHPATH,
                                   settings_config_dir);
-            g_spawn_command_line_sync(command.c_str(), nullptr, nullptr, nullptr, nullptr);
-            LOG_INFO("Updated git copy of: {}", session);
+            g_spawn_command_line_async(command.c_str(), nullptr);
+            LOG_INFO("Updating git copy of: {}", session);
         }
         else if (std::filesystem::exists(git_path))
         {
@@ -545,6 +554,80 @@ load_settings(const char* config_dir)
     ptk_bookmark_view_get_first_bookmark(nullptr);
 }
 
+/* The session text is built by save_settings() and written by a writer
+ * thread. Saves requested while a write is running are coalesced, only the
+ * latest text is written, and a text equal to the last one is not written. */
+struct SessionWriter
+{
+    std::mutex lock;
+    std::condition_variable idle;
+    bool running{false};
+    bool has_pending{false};
+    std::string pending;
+    std::string last; // latest text passed to the writer
+};
+
+static SessionWriter session_writer;
+
+static void*
+session_write_thread(void* user_data)
+{
+    (void)user_data;
+    const std::string path = vfs_build_path(settings_config_dir, "session");
+
+    std::unique_lock<std::mutex> lock(session_writer.lock);
+    while (session_writer.has_pending)
+    {
+        std::string data = std::move(session_writer.pending);
+        session_writer.has_pending = false;
+        lock.unlock();
+
+        // g_file_set_contents writes to a tmpfile and renames it over the old session
+        GError* error = nullptr;
+        bool written = g_file_set_contents(path.c_str(), data.data(), data.size(), &error);
+        if (!written)
+        {
+            LOG_ERROR("saving session file failed: {}", error->message);
+            g_error_free(error);
+        }
+
+        lock.lock();
+        if (!written && !session_writer.has_pending)
+            session_writer.last.clear(); // retry on the next save
+    }
+    session_writer.running = false;
+    session_writer.idle.notify_all();
+    return nullptr;
+}
+
+static void
+session_write(std::string&& buf)
+{
+    std::lock_guard<std::mutex> lock(session_writer.lock);
+    if (buf == session_writer.last)
+        return; // unchanged since the last save
+
+    session_writer.last = buf;
+    session_writer.pending = std::move(buf);
+    session_writer.has_pending = true;
+    if (!session_writer.running)
+    {
+        session_writer.running = true;
+        g_thread_unref(g_thread_new("session_write", session_write_thread, nullptr));
+    }
+}
+
+static void
+session_write_wait()
+{
+    std::unique_lock<std::mutex> lock(session_writer.lock);
+    session_writer.idle.wait(lock,
+                             []
+                             {
+                                 return !session_writer.running;
+                             });
+}
+
 void
 save_settings(void* main_window_ptr)
 {
@@ -665,19 +748,15 @@ save_settings(void* main_window_ptr)
     xset_write(buf);
     // clang-format on
 
-    // move
-    std::string path = g_build_filename(settings_config_dir.c_str(), "session", nullptr);
-    std::ofstream file(path);
-    if (file.is_open())
-        file << buf;
-    else
-        LOG_ERROR("saving session file failed");
-    file.close();
+    session_write(std::move(buf));
 }
 
 void
 free_settings()
 {
+    // the last save must reach the disk before exit
+    session_write_wait();
+
     if (!xset_cmd_history.empty())
         xset_cmd_history.clear();
 
@@ -1763,7 +1842,10 @@ xset_context_new()
         xset_context = g_slice_new0(XSetContext);
         xset_context->valid = false;
         for (i = 0; i < G_N_ELEMENTS(xset_context->var); i++)
+        {
             xset_context->var[i] = nullptr;
+            xset_context->var_down[i] = nullptr;
+        }
     }
     else
     {
@@ -1773,6 +1855,8 @@ xset_context_new()
             if (xset_context->var[i])
                 g_free(xset_context->var[i]);
             xset_context->var[i] = nullptr;
+            g_free(xset_context->var_down[i]);
+            xset_context->var_down[i] = nullptr;
         }
     }
     return xset_context;
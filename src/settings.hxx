@@ -78,6 +78,9 @@ struct ConfigSettings
     const char* font_general{nullptr}; // NOOP
 
     bool git_backed_settings{true};
+
+    bool dir_snapshot_cache{false};
+    int dir_cache_size{64}; // MiB
 };
 
 extern ConfigSettings config_settings;
@@ -342,6 +345,7 @@ struct XSetContext
 {
     bool valid;
     char* var[40];
+    char* var_down[40]; // lowercase var, filled when first matched by xset_context_test
 };
 
 void xset_set_window_icon(GtkWindow* win);
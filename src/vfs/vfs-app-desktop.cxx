@@ -11,8 +11,13 @@
  */
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include <mutex>
+
+#include <sys/stat.h>
+
 #include "vendor/ztd/ztd.hxx"
 
 // sfm breaks vfs independence for exec_in_terminal
@@ -27,17 +32,65 @@
 #include "utils.hxx"
 #include "logger.hxx"
 
+/* Parsed desktop files by desktop id or absolute path. Ids are forgotten
+ * when an applications dir changes, absolute paths are checked by mtime. */
+#define VFS_APP_DESKTOP_CACHE_MAX 1024
+
+struct VFSAppDesktopCached
+{
+    VFSAppDesktop desktop;
+    struct timespec mtime;
+};
+
+static std::unordered_map<std::string, VFSAppDesktopCached> desktop_cache;
+static std::mutex desktop_cache_lock;
+
+static struct timespec
+desktop_file_mtime(const std::string& open_file_name)
+{
+    struct timespec mtime = {0, 0};
+    struct stat file_stat;
+    if (g_path_is_absolute(open_file_name.c_str()) && stat(open_file_name.c_str(), &file_stat) == 0)
+        mtime = file_stat.st_mtim;
+    return mtime;
+}
+
 VFSAppDesktop::VFSAppDesktop(const std::string& open_file_name)
 {
     // LOG_INFO("VFSAppDesktop constructor");
 
+    const struct timespec mtime = desktop_file_mtime(open_file_name);
+    {
+        std::lock_guard<std::mutex> lock(desktop_cache_lock);
+        auto it = desktop_cache.find(open_file_name);
+        if (it != desktop_cache.end() && it->second.mtime.tv_sec == mtime.tv_sec &&
+            it->second.mtime.tv_nsec == mtime.tv_nsec)
+        {
+            *this = it->second.desktop;
+            return;
+        }
+    }
+
+    load(open_file_name);
+
+    std::lock_guard<std::mutex> lock(desktop_cache_lock);
+    if (desktop_cache.size() >= VFS_APP_DESKTOP_CACHE_MAX)
+        desktop_cache.clear();
+    desktop_cache.insert_or_assign(open_file_name, VFSAppDesktopCached{*this, mtime});
+}
+
+void
+VFSAppDesktop::load(const std::string& open_file_name)
+{
     bool load;
 
     GKeyFile* file = g_key_file_new();
 
     if (g_path_is_absolute(open_file_name.c_str()))
     {
-        m_file_name = g_path_get_basename(open_file_name.c_str());
+        char* file_name = g_path_get_basename(open_file_name.c_str());
+        m_file_name = file_name;
+        g_free(file_name);
         m_full_path = open_file_name;
         load = g_key_file_load_from_file(file, open_file_name.c_str(), G_KEY_FILE_NONE, nullptr);
     }
@@ -83,6 +136,13 @@ VFSAppDesktop::~VFSAppDesktop()
     // LOG_INFO("VFSAppDesktop destructor");
 }
 
+void
+vfs_app_desktop_cache_clear()
+{
+    std::lock_guard<std::mutex> lock(desktop_cache_lock);
+    desktop_cache.clear();
+}
+
 const char*
 VFSAppDesktop::get_name()
 {
@@ -36,6 +36,8 @@ class VFSAppDesktop
                     std::vector<std::string>& file_paths, GError** err);
 
   private:
+    void load(const std::string& open_file_name);
+
     // desktop entry spec keys
     std::string m_file_name;
     std::string m_disp_name;
@@ -53,3 +55,7 @@ class VFSAppDesktop
     void exec_desktop(GdkScreen* screen, const std::string& working_dir,
                       std::vector<std::string>& file_paths, GError** err);
 };
+
+/* Desktop files are parsed once, their icons are cached by vfs_load_icon().
+ * Forget them after an applications dir changed. */
+void vfs_app_desktop_cache_clear();
@@ -224,6 +224,14 @@ vfs_async_task_cancel(VFSAsyncTask* task)
     vfs_async_task_real_cancel(task, false);
 }
 
+void
+vfs_async_task_request_cancel(VFSAsyncTask* task)
+{
+    vfs_async_task_lock(task);
+    task->cancel = true;
+    vfs_async_task_unlock(task);
+}
+
 static void
 vfs_async_task_finish(VFSAsyncTask* task, bool is_cancelled)
 {
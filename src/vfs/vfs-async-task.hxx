@@ -69,5 +69,11 @@ bool vfs_async_task_is_cancelled(VFSAsyncTask* task);
  */
 void vfs_async_task_cancel(VFSAsyncTask* task);
 
+/*
+ * Ask the task to stop without waiting for its thread,
+ * "finish" is still emitted once the thread is done.
+ */
+void vfs_async_task_request_cancel(VFSAsyncTask* task);
+
 void vfs_async_task_lock(VFSAsyncTask* task);
 void vfs_async_task_unlock(VFSAsyncTask* task);
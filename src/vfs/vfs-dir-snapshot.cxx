@@ -0,0 +1,336 @@
+/*
+ *  C Implementation: vfs-dir-snapshot
+ *
+ * Description: On-disk cache of directory listings
+ *
+ *
+ *
+ * Copyright: See COPYING file that comes with this distribution
+ *
+ */
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+
+#include <cstdint>
+#include <ctime>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include "settings.hxx"
+#include "logger.hxx"
+
+#include "vfs/vfs-user-dir.hxx"
+#include "vfs/vfs-file-info.hxx"
+
+#include "mime-type/mime-type.hxx"
+
+#include "vfs/vfs-dir-snapshot.hxx"
+
+#ifdef USE_XXHASH
+#include "xxhash.h"
+#endif
+
+/*
+ * File layout, host byte order:
+ *   SnapshotHeader
+ *   SnapshotEntry[n_entries]
+ *   strings block: dir path, then NUL terminated mime database stamp,
+ *                  names and mime types
+ * All offsets are relative to the start of the strings block.
+ */
+
+#define SNAPSHOT_MAGIC   "SFMD"
+#define SNAPSHOT_VERSION 2
+
+/* snapshots kept, the ones saved least recently are removed first */
+#define SNAPSHOT_MAX_FILES 256
+
+struct SnapshotHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t dir_dev;
+    uint64_t dir_ino;
+    int64_t dir_mtime_sec;
+    int64_t dir_mtime_nsec;
+    uint32_t n_entries;
+    uint32_t n_hidden;
+    uint32_t strings_size;
+    uint32_t mime_stamp_off; /* mime_type_get_cache_stamp() the types were detected with */
+};
+
+struct SnapshotEntry
+{
+    uint64_t dev;
+    int64_t size;
+    int64_t mtime;
+    int64_t atime;
+    int64_t blocks;
+    uint32_t mode;
+    uint32_t uid;
+    uint32_t gid;
+    uint32_t blksize;
+    uint32_t name_off;
+    uint32_t mime_off;
+    uint8_t mime_from_content;
+    uint8_t text_check;
+    uint8_t reserved[6];
+};
+
+struct SnapshotWrite
+{
+    std::string file;
+    std::string data;
+};
+
+bool
+vfs_dir_snapshot_enabled()
+{
+    return config_settings.dir_snapshot_cache;
+}
+
+static const std::string
+snapshot_dir()
+{
+    return vfs_build_path(vfs_user_cache_dir(), "spacefm", "dir-snapshots");
+}
+
+static const std::string
+snapshot_file(const char* path)
+{
+    std::string file_name;
+#ifdef USE_XXHASH
+    XXH64_hash_t hash = XXH3_64bits(path, strlen(path));
+    file_name = fmt::format("{}.snapshot", hash);
+#else
+    GChecksum* cs = g_checksum_new(G_CHECKSUM_MD5);
+    g_checksum_update(cs, (const unsigned char*)path, strlen(path));
+    file_name = fmt::format("{}.snapshot", g_checksum_get_string(cs));
+    g_checksum_free(cs);
+#endif
+    return vfs_build_path(snapshot_dir(), file_name);
+}
+
+bool
+vfs_dir_snapshot_load(const char* path, VFSDirSnapshotFunc func, void* user_data,
+                      long* xhidden_count)
+{
+    struct stat dir_stat;
+    if (stat(path, &dir_stat) == -1)
+        return false;
+
+    const std::string file = snapshot_file(path);
+    int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return false;
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == -1 || (std::size_t)file_stat.st_size < sizeof(SnapshotHeader))
+    {
+        close(fd);
+        return false;
+    }
+
+    // snapshots are replaced by rename, never truncated in place, so the mapping is safe
+    std::size_t size = file_stat.st_size;
+    const char* buf =
+        static_cast<const char*>(mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0));
+    close(fd);
+    if (buf == MAP_FAILED)
+        return false;
+
+    bool ret = false;
+    const SnapshotHeader* header = reinterpret_cast<const SnapshotHeader*>(buf);
+    const SnapshotEntry* entries =
+        reinterpret_cast<const SnapshotEntry*>(buf + sizeof(SnapshotHeader));
+    const char* strings = buf + sizeof(SnapshotHeader) + header->n_entries * sizeof(SnapshotEntry);
+
+    if (memcmp(header->magic, SNAPSHOT_MAGIC, 4) || header->version != SNAPSHOT_VERSION ||
+        size != sizeof(SnapshotHeader) + header->n_entries * sizeof(SnapshotEntry) +
+                    header->strings_size ||
+        header->strings_size == 0 || strings[header->strings_size - 1] != '\0' ||
+        header->mime_stamp_off >= header->strings_size)
+    {
+        LOG_WARN("Invalid directory snapshot: {}", file);
+    }
+    else if (strcmp(strings, path) || header->dir_dev != dir_stat.st_dev ||
+             header->dir_ino != dir_stat.st_ino ||
+             header->dir_mtime_sec != dir_stat.st_mtim.tv_sec ||
+             header->dir_mtime_nsec != dir_stat.st_mtim.tv_nsec)
+    {
+        // directory changed since the snapshot was taken
+    }
+    else if (mime_type_get_cache_stamp() != strings + header->mime_stamp_off)
+    {
+        // mime database changed, the types would be detected differently
+    }
+    else
+    {
+        for (uint32_t i = 0; i < header->n_entries; ++i)
+        {
+            const SnapshotEntry* entry = &entries[i];
+            if (entry->name_off >= header->strings_size ||
+                entry->mime_off >= header->strings_size)
+                continue;
+
+            struct stat entry_stat;
+            memset(&entry_stat, 0, sizeof(entry_stat));
+            entry_stat.st_dev = entry->dev;
+            entry_stat.st_mode = entry->mode;
+            entry_stat.st_uid = entry->uid;
+            entry_stat.st_gid = entry->gid;
+            entry_stat.st_size = entry->size;
+            entry_stat.st_mtime = entry->mtime;
+            entry_stat.st_atime = entry->atime;
+            entry_stat.st_blksize = entry->blksize;
+            entry_stat.st_blocks = entry->blocks;
+
+            MimeTextCheck text_check = entry->text_check <= MIME_TEXT_PLAIN
+                                           ? (MimeTextCheck)entry->text_check
+                                           : MIME_TEXT_UNCHECKED;
+            func(strings + entry->name_off,
+                 &entry_stat,
+                 strings + entry->mime_off,
+                 entry->mime_from_content,
+                 text_check,
+                 user_data);
+        }
+        if (xhidden_count)
+            *xhidden_count = header->n_hidden;
+        ret = true;
+    }
+
+    munmap((void*)buf, size);
+    return ret;
+}
+
+static void
+snapshot_prune()
+{
+    const std::string dir = snapshot_dir();
+    GDir* dir_content = g_dir_open(dir.c_str(), 0, nullptr);
+    if (!dir_content)
+        return;
+
+    std::vector<std::pair<std::time_t, std::string>> snapshots;
+    const char* file_name;
+    while ((file_name = g_dir_read_name(dir_content)))
+    {
+        if (!g_str_has_suffix(file_name, ".snapshot"))
+            continue;
+        std::string file = vfs_build_path(dir, file_name);
+        struct stat file_stat;
+        if (stat(file.c_str(), &file_stat) == 0)
+            snapshots.emplace_back(file_stat.st_mtime, std::move(file));
+    }
+    g_dir_close(dir_content);
+
+    if (snapshots.size() <= SNAPSHOT_MAX_FILES)
+        return;
+    // every close saves a dir again, so the oldest are the least recently used
+    std::sort(snapshots.begin(),
+              snapshots.end(),
+              [](const auto& a, const auto& b) { return a.first > b.first; });
+    for (std::size_t i = SNAPSHOT_MAX_FILES; i < snapshots.size(); ++i)
+        unlink(snapshots[i].second.c_str());
+}
+
+static void*
+snapshot_write_thread(void* user_data)
+{
+    SnapshotWrite* write = static_cast<SnapshotWrite*>(user_data);
+
+    g_mkdir_with_parents(snapshot_dir().c_str(), 0700);
+
+    // g_file_set_contents writes to a tmpfile and renames it over the old snapshot
+    GError* error = nullptr;
+    if (!g_file_set_contents(write->file.c_str(), write->data.data(), write->data.size(), &error))
+    {
+        LOG_WARN("Failed to save directory snapshot {}: {}", write->file, error->message);
+        g_error_free(error);
+    }
+    snapshot_prune();
+
+    delete write;
+    return nullptr;
+}
+
+void
+vfs_dir_snapshot_save(const char* path, GList* file_list, long xhidden_count)
+{
+    struct stat dir_stat;
+    if (stat(path, &dir_stat) == -1)
+        return;
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, 4);
+    header.version = SNAPSHOT_VERSION;
+    header.dir_dev = dir_stat.st_dev;
+    header.dir_ino = dir_stat.st_ino;
+    header.dir_mtime_sec = dir_stat.st_mtim.tv_sec;
+    header.dir_mtime_nsec = dir_stat.st_mtim.tv_nsec;
+    header.n_hidden = xhidden_count;
+
+    std::string entries;
+    std::string strings;
+    strings.append(path, strlen(path) + 1);
+    const std::string mime_stamp = mime_type_get_cache_stamp();
+    header.mime_stamp_off = strings.size();
+    strings.append(mime_stamp.c_str(), mime_stamp.size() + 1);
+
+    // a directory only has a handful of distinct mime types
+    std::unordered_map<std::string, uint32_t> mime_offsets;
+
+    for (GList* l = file_list; l; l = l->next)
+    {
+        VFSFileInfo* file = static_cast<VFSFileInfo*>(l->data);
+        if (!file->name || !file->mime_type)
+            continue;
+
+        SnapshotEntry entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.dev = file->dev;
+        entry.size = file->size;
+        entry.mtime = file->mtime;
+        entry.atime = file->atime;
+        entry.blocks = file->blocks;
+        entry.mode = file->mode;
+        entry.uid = file->uid;
+        entry.gid = file->gid;
+        entry.blksize = file->blksize;
+        entry.mime_from_content = file->mime_from_content;
+        entry.text_check = file->text_check;
+
+        entry.name_off = strings.size();
+        strings.append(file->name, strlen(file->name) + 1);
+
+        const char* mime = vfs_mime_type_get_type(file->mime_type);
+        auto it = mime_offsets.find(mime);
+        if (it == mime_offsets.end())
+        {
+            entry.mime_off = strings.size();
+            mime_offsets.emplace(mime, entry.mime_off);
+            strings.append(mime, strlen(mime) + 1);
+        }
+        else
+            entry.mime_off = it->second;
+
+        entries.append(reinterpret_cast<const char*>(&entry), sizeof(entry));
+        ++header.n_entries;
+    }
+    header.strings_size = strings.size();
+
+    SnapshotWrite* write = new SnapshotWrite;
+    write->file = snapshot_file(path);
+    write->data.reserve(sizeof(header) + entries.size() + strings.size());
+    write->data.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    write->data.append(entries);
+    write->data.append(strings);
+
+    g_thread_unref(g_thread_new("dir_snapshot", snapshot_write_thread, write));
+}
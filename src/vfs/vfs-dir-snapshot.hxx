@@ -0,0 +1,43 @@
+/*
+ *  C Interface: vfs-dir-snapshot
+ *
+ * Description: On-disk cache of directory listings
+ *
+ *
+ *
+ * Copyright: See COPYING file that comes with this distribution
+ *
+ */
+
+#pragma once
+
+#include <sys/stat.h>
+
+#include <glib.h>
+
+#include "mime-type/mime-type.hxx"
+
+/* smaller dirs relist faster than a snapshot can be validated */
+#define VFS_DIR_SNAPSHOT_MIN_FILES 500
+
+/* called for every entry of a valid snapshot, with how its mime type was detected */
+typedef void (*VFSDirSnapshotFunc)(const char* name, struct stat* file_stat,
+                                   const char* mime_type, bool mime_from_content,
+                                   MimeTextCheck text_check, void* user_data);
+
+bool vfs_dir_snapshot_enabled();
+
+/*
+ * Load the snapshot of path if one exists, the directory inode and mtime
+ * still match the ones recorded when it was saved, and the mime database
+ * has not changed since.
+ * Returns false without calling func if there is no valid snapshot.
+ */
+bool vfs_dir_snapshot_load(const char* path, VFSDirSnapshotFunc func, void* user_data,
+                           long* xhidden_count);
+
+/*
+ * Save file_list (a list of VFSFileInfo) as the snapshot of path.
+ * The list is serialized in the calling thread and written in the background.
+ */
+void vfs_dir_snapshot_save(const char* path, GList* file_list, long xhidden_count);
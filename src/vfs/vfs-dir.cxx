@@ -11,8 +11,14 @@
 
 #include <string>
 #include <filesystem>
+#include <fstream>
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+#include <mutex>
 
 #include <fcntl.h>
+#include <sys/resource.h>
 
 #if defined(__GLIBC__)
 #include <malloc.h>
@@ -22,6 +28,9 @@
 
 #include "vfs/vfs-volume.hxx"
 #include "vfs/vfs-thumbnail-loader.hxx"
+#include "vfs/vfs-statx-batch.hxx"
+#include "vfs/vfs-dir-snapshot.hxx"
+#include "settings.hxx"
 #include "utils.hxx"
 
 #include "vfs/vfs-user-dir.hxx"
@@ -37,14 +46,23 @@ static void vfs_dir_set_property(GObject* obj, unsigned int prop_id, const GValu
 static void vfs_dir_get_property(GObject* obj, unsigned int prop_id, GValue* value,
                                  GParamSpec* pspec);
 
-static char* gethidden(const char* path);                        // MOD added
-static bool ishidden(const char* hidden, const char* file_name); // MOD added
+static GHashTable* gethidden(const char* path); // MOD added
+static GHashTable* vfs_dir_get_hidden(VFSDir* dir);
 
 /* constructor is private */
-static VFSDir* vfs_dir_new(const char* path);
+static VFSDir* vfs_dir_new(const char* path, bool speculative);
 
-static void vfs_dir_load(VFSDir* dir);
+static void vfs_dir_load(VFSDir* dir, bool speculative);
 static void* vfs_dir_load_thread(VFSAsyncTask* task, VFSDir* dir);
+static void* vfs_dir_prefetch_thread(VFSAsyncTask* task, VFSDir* dir);
+static void vfs_dir_load_file(VFSDir* dir, const char* file_name);
+static void vfs_dir_load_stat(const char* file_name, struct stat* file_stat, void* user_data);
+static void vfs_dir_load_snapshot_entry(const char* file_name, struct stat* file_stat,
+                                        const char* mime_type, bool mime_from_content,
+                                        MimeTextCheck text_check, void* user_data);
+static void* vfs_dir_revalidate_thread(VFSAsyncTask* task, VFSDir* dir);
+static void* vfs_dir_sniff_thread(VFSAsyncTask* task, VFSDir* dir);
+static void* vfs_dir_retype_thread(VFSAsyncTask* task, VFSDir* dir);
 
 static void vfs_dir_monitor_callback(VFSFileMonitor* fm, VFSFileMonitorEvent event,
                                      const char* file_name, void* user_data);
@@ -56,6 +74,20 @@ static bool notify_file_change(void* user_data);
 static bool update_file_info(VFSDir* dir, VFSFileInfo* file);
 
 static void on_list_task_finished(VFSAsyncTask* task, bool is_cancelled, VFSDir* dir);
+static void vfs_dir_trim_retained(uint64_t max_bytes, unsigned int max_count);
+static bool vfs_dir_evict_retained(VFSDir* keep);
+static void on_revalidate_task_finished(VFSAsyncTask* task, bool is_cancelled, VFSDir* dir);
+static void on_sniff_task_finished(VFSAsyncTask* task, bool is_cancelled, VFSDir* dir);
+static void on_retype_task_finished(VFSAsyncTask* task, bool is_cancelled, VFSDir* dir);
+
+/* differences between a snapshot listing and the dir on disk */
+struct VFSDirRevalidation
+{
+    std::vector<std::string> created;
+    std::vector<std::string> changed;
+    std::vector<std::string> deleted;
+    long xhidden_count{0};
+};
 
 enum VFSDirSignal
 {
@@ -70,11 +102,30 @@ enum VFSDirSignal
 static unsigned int signals[N_SIGNALS] = {0};
 static GObjectClass* parent_class = nullptr;
 
+/* max concurrent stat calls when loading a dir on a high-latency filesystem */
+#define VFS_DIR_LOAD_WORKERS 8
+
+/* max number of closed dirs kept loaded, each one holds an inotify watch */
+#define VFS_DIR_RETAIN_MAX 32
+
+/* ms before a prefetch starts, so sweeping the pointer over rows costs nothing */
+#define VFS_DIR_PREFETCH_DELAY 250
+
+/* ms between batches of mime types found by checking file contents */
+#define VFS_DIR_SNIFF_INTERVAL 200
+
 static GHashTable* dir_hash = nullptr;
+/* most recently used first, each entry holds a ref so closed dirs stay loaded */
+static std::vector<VFSDir*> retained_dirs;
 static GList* mime_cb = nullptr;
+static uint64_t mime_magic_hash = 0; /* magic rules the listed types were detected with */
 static unsigned int change_notify_timeout = 0;
 static unsigned int theme_change_notify = 0;
 
+static VFSDir* prefetch_dir = nullptr;
+static char* prefetch_path = nullptr;
+static unsigned int prefetch_timer = 0;
+
 GType
 vfs_dir_get_type()
 {
@@ -212,9 +263,38 @@ vfs_dir_finalize(GObject* obj)
 {
     VFSDir* dir = VFS_DIR(obj);
     // LOG_INFO("vfs_dir_finalize  {}", dir->path);
+
+    /* Keep the listing of a large dir so reopening it is instant.
+     * Skip it while a snapshot listing is still being revalidated,
+     * or some mime types are still provisional. */
+    if (dir->path && dir->load_complete && !dir->revalidate_task && !dir->sniff_task &&
+        !dir->retype_task && dir->sniff_files.empty() && dir->sniffed.empty() &&
+        dir->n_files >= VFS_DIR_SNAPSHOT_MIN_FILES && vfs_dir_snapshot_enabled())
+    {
+        vfs_dir_snapshot_save(dir->path, dir->file_list, dir->xhidden_count);
+    }
+
+    // stop the sniff and retype threads first, they add sources with dir as user data
+    if (G_UNLIKELY(dir->sniff_task))
+    {
+        g_signal_handlers_disconnect_by_func(dir->sniff_task, (void*)on_sniff_task_finished, dir);
+        vfs_async_task_cancel(dir->sniff_task);
+        g_object_unref(dir->sniff_task);
+        dir->sniff_task = nullptr;
+    }
+    if (G_UNLIKELY(dir->retype_task))
+    {
+        g_signal_handlers_disconnect_by_func(dir->retype_task,
+                                             (void*)on_retype_task_finished,
+                                             dir);
+        vfs_async_task_cancel(dir->retype_task);
+        g_object_unref(dir->retype_task);
+        dir->retype_task = nullptr;
+    }
     do
     {
     } while (g_source_remove_by_user_data(dir));
+    dir->sniff_timer = 0;
 
     if (G_UNLIKELY(dir->task))
     {
@@ -226,6 +306,16 @@ vfs_dir_finalize(GObject* obj)
         g_object_unref(dir->task);
         dir->task = nullptr;
     }
+    if (G_UNLIKELY(dir->revalidate_task))
+    {
+        g_signal_handlers_disconnect_by_func(dir->revalidate_task,
+                                             (void*)on_revalidate_task_finished,
+                                             dir);
+        vfs_async_task_cancel(dir->revalidate_task);
+        delete static_cast<VFSDirRevalidation*>(dir->revalidate_task->ret_val);
+        g_object_unref(dir->revalidate_task);
+        dir->revalidate_task = nullptr;
+    }
     if (dir->monitor)
     {
         vfs_file_monitor_remove(dir->monitor, vfs_dir_monitor_callback, dir);
@@ -234,7 +324,9 @@ vfs_dir_finalize(GObject* obj)
     {
         if (G_LIKELY(dir_hash))
         {
-            g_hash_table_remove(dir_hash, dir->path);
+            // a dropped prefetch was already replaced by any dir opened since
+            if (!dir->prefetch_dropped)
+                g_hash_table_remove(dir_hash, dir->path);
 
             /* There is no VFSDir instance */
             if (g_hash_table_size(dir_hash) == 0)
@@ -291,6 +383,19 @@ vfs_dir_finalize(GObject* obj)
         dir->created_files = nullptr;
     }
 
+    for (VFSFileInfo* file: dir->sniff_files)
+        vfs_file_info_unref(file);
+    dir->sniff_files.clear();
+    for (VFSSniffedFile& sniffed: dir->sniffed)
+        vfs_file_info_unref(sniffed.file);
+    dir->sniffed.clear();
+
+    if (dir->hidden_files)
+    {
+        g_hash_table_unref(dir->hidden_files);
+        dir->hidden_files = nullptr;
+    }
+
     vfs_dir_clear(dir);
     G_OBJECT_CLASS(parent_class)->finalize(obj);
 }
@@ -475,33 +580,137 @@ vfs_dir_emit_thumbnail_loaded(VFSDir* dir, VFSFileInfo* file)
 
 /* methods */
 
+static void
+vfs_dir_check_volume(VFSDir* dir)
+{
+    dir->volume_unchecked = false;
+    dir->avoid_changes = vfs_volume_dir_avoid_changes(dir->path);
+    dir->parallel_load = dir->avoid_changes || vfs_volume_dir_is_network(dir->path);
+    // LOG_INFO("vfs_dir_new {}  avoid_changes={}", dir->path, dir->avoid_changes ? "true" :
+    // "false");
+}
+
 static VFSDir*
-vfs_dir_new(const char* path)
+vfs_dir_new(const char* path, bool speculative)
 {
     VFSDir* dir = static_cast<VFSDir*>(g_object_new(VFS_TYPE_DIR, nullptr));
     dir->path = g_strdup(path);
 
-    dir->avoid_changes = vfs_volume_dir_avoid_changes(path);
-    // LOG_INFO("vfs_dir_new {}  avoid_changes={}", dir->path, dir->avoid_changes ? "true" :
-    // "false");
+    /* Both volume lookups stat the dir, which can hang on a dead mount.
+     * A guess is not worth that, so a prefetched dir is looked up once
+     * it is opened. */
+    dir->volume_unchecked = speculative;
+    if (!speculative)
+        vfs_dir_check_volume(dir);
     return dir;
 }
 
+/* Called by the task finish handlers. A dropped prefetch is let go with its
+ * last task, and nothing more is started for it. */
+static bool
+vfs_dir_prefetch_release(VFSDir* dir)
+{
+    if (G_LIKELY(!dir->prefetch_dropped))
+        return false;
+    if (!dir->task && !dir->revalidate_task && !dir->sniff_task && !dir->retype_task)
+        g_object_unref(dir);
+    return true;
+}
+
 void
 on_list_task_finished(VFSAsyncTask* task, bool is_cancelled, VFSDir* dir)
 {
     (void)task;
     g_object_unref(dir->task);
     dir->task = nullptr;
+
+    if (vfs_dir_prefetch_release(dir))
+        return;
+
     g_signal_emit(dir, signals[FILE_LISTED_SIGNAL], 0, is_cancelled);
     dir->file_listed = true;
     dir->load_complete = true;
+
+    if (dir->from_snapshot && !is_cancelled)
+    {
+        dir->revalidate_task =
+            vfs_async_task_new((VFSAsyncFunc)vfs_dir_revalidate_thread, dir);
+        g_signal_connect(dir->revalidate_task,
+                         "finish",
+                         G_CALLBACK(on_revalidate_task_finished),
+                         dir);
+        vfs_async_task_execute(dir->revalidate_task);
+    }
+
+    /* Listing only guessed mime types from names, now check
+     * the content of the files that need it */
+    if (!dir->sniff_files.empty() && !is_cancelled)
+    {
+        dir->sniff_task = vfs_async_task_new((VFSAsyncFunc)vfs_dir_sniff_thread, dir);
+        g_signal_connect(dir->sniff_task, "finish", G_CALLBACK(on_sniff_task_finished), dir);
+        vfs_async_task_execute(dir->sniff_task);
+    }
+
+    /* Out of inotify watches, give back the ones held by closed dirs,
+     * least recently used first, until this one gets a watch. Other
+     * failures are not helped by that. */
+    while (!dir->monitor && dir->monitor_error == ENOSPC && dir->path &&
+           vfs_dir_evict_retained(dir))
+    {
+        dir->monitor = vfs_file_monitor_add(dir->path, vfs_dir_monitor_callback, dir);
+        dir->monitor_error = dir->monitor ? 0 : errno;
+    }
+}
+
+void
+on_revalidate_task_finished(VFSAsyncTask* task, bool is_cancelled, VFSDir* dir)
+{
+    VFSDirRevalidation* result = static_cast<VFSDirRevalidation*>(task->ret_val);
+    if (result && !is_cancelled)
+    {
+        for (const std::string& file_name: result->created)
+            vfs_dir_emit_file_created(dir, file_name.c_str(), true);
+        for (const std::string& file_name: result->changed)
+            vfs_dir_emit_file_changed(dir, file_name.c_str(), nullptr, true);
+        for (const std::string& file_name: result->deleted)
+            vfs_dir_emit_file_deleted(dir, file_name.c_str(), nullptr);
+        dir->xhidden_count = result->xhidden_count;
+    }
+    delete result;
+
+    g_object_unref(dir->revalidate_task);
+    dir->revalidate_task = nullptr;
+    dir->from_snapshot = false;
+    vfs_dir_prefetch_release(dir);
 }
 
-static char*
+void
+on_sniff_task_finished(VFSAsyncTask* task, bool is_cancelled, VFSDir* dir)
+{
+    (void)task;
+    (void)is_cancelled;
+    // the last batch is still delivered by sniff_timer
+    g_object_unref(dir->sniff_task);
+    dir->sniff_task = nullptr;
+    vfs_dir_prefetch_release(dir);
+}
+
+void
+on_retype_task_finished(VFSAsyncTask* task, bool is_cancelled, VFSDir* dir)
+{
+    (void)task;
+    if (!is_cancelled)
+        dir->retype_content = false;
+    // the last batch is still delivered by sniff_timer
+    g_object_unref(dir->retype_task);
+    dir->retype_task = nullptr;
+    vfs_dir_prefetch_release(dir);
+}
+
+static GHashTable*
 gethidden(const char* path) // MOD added
 {
-    // Read .hidden into string
+    // Read .hidden into a set of file names
     char* hidden_path = g_build_filename(path, ".hidden", nullptr);
 
     // test access first because open() on missing file may cause
@@ -512,6 +721,7 @@ gethidden(const char* path) // MOD added
         return nullptr;
     }
 
+    char* buf = nullptr;
     int fd = open(hidden_path, O_RDONLY);
     g_free(hidden_path);
     if (fd != -1)
@@ -519,53 +729,88 @@ gethidden(const char* path) // MOD added
         struct stat s; // skip stat
         if (G_LIKELY(fstat(fd, &s) != -1))
         {
-            char* buf = static_cast<char*>(g_malloc(s.st_size + 1));
+            buf = static_cast<char*>(g_malloc(s.st_size + 1));
             if ((s.st_size = read(fd, buf, s.st_size)) != -1)
-            {
                 buf[s.st_size] = 0;
-                close(fd);
-                return buf;
-            }
             else
+            {
                 g_free(buf);
+                buf = nullptr;
+            }
         }
         close(fd);
     }
-    return nullptr;
+    if (!buf)
+        return nullptr;
+
+    // one file name per line
+    GHashTable* hidden = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, nullptr);
+    char* line = buf;
+    while (*line)
+    {
+        char* end = strchr(line, '\n');
+        if (!end)
+            end = line + strlen(line);
+        if (end != line)
+            g_hash_table_add(hidden, g_strndup(line, end - line));
+        line = *end ? end + 1 : end;
+    }
+    g_free(buf);
+    return hidden;
 }
 
-static bool
-ishidden(const char* hidden, const char* file_name) // MOD added
-{                                                   // assumes hidden,file_name != nullptr
-    char c;
-    char* str = (char*)strstr(hidden, file_name);
-    while (str)
+/* The parsed .hidden of dir, or nullptr if there is none.
+ * It is read once and reused until the monitor sees .hidden change.
+ * Callable from any thread, unref the result when done. */
+static GHashTable*
+vfs_dir_get_hidden(VFSDir* dir)
+{
+    vfs_dir_lock(dir);
+    if (!dir->hidden_loaded)
     {
-        if (str == hidden)
+        const unsigned int serial = dir->hidden_serial;
+        vfs_dir_unlock(dir);
+
+        // read outside the lock, it can be slow on nfs
+        GHashTable* hidden = gethidden(dir->path);
+
+        vfs_dir_lock(dir);
+        if (!dir->hidden_loaded && serial == dir->hidden_serial)
         {
-            // file_name is at start of buffer
-            c = hidden[strlen(file_name)];
-            if (c == '\n' || c == '\0')
-                return true;
+            dir->hidden_files = hidden;
+            dir->hidden_loaded = true;
         }
         else
         {
-            c = str[strlen(file_name)];
-            if (str[-1] == '\n' && (c == '\n' || c == '\0'))
-                return true;
+            // changed again while reading, use it once without caching
+            vfs_dir_unlock(dir);
+            return hidden;
         }
-        str = strstr(++str, file_name);
     }
-    return false;
+    GHashTable* hidden = dir->hidden_files ? g_hash_table_ref(dir->hidden_files) : nullptr;
+    vfs_dir_unlock(dir);
+    return hidden;
+}
+
+static void
+vfs_dir_invalidate_hidden(VFSDir* dir)
+{
+    vfs_dir_lock(dir);
+    if (dir->hidden_files)
+        g_hash_table_unref(dir->hidden_files);
+    dir->hidden_files = nullptr;
+    dir->hidden_loaded = false;
+    ++dir->hidden_serial;
+    vfs_dir_unlock(dir);
 }
 
 bool
 vfs_dir_add_hidden(const char* path, const char* file_name)
 {
     bool ret = true;
-    char* hidden = gethidden(path);
+    GHashTable* hidden = gethidden(path);
 
-    if (!(hidden && ishidden(hidden, file_name)))
+    if (!(hidden && g_hash_table_contains(hidden, file_name)))
     {
         char* buf = g_strdup_printf("%s\n", file_name);
         char* file_path = g_build_filename(path, ".hidden", nullptr);
@@ -585,28 +830,148 @@ vfs_dir_add_hidden(const char* path, const char* file_name)
     }
 
     if (hidden)
-        g_free(hidden);
+        g_hash_table_unref(hidden);
     return ret;
 }
 
 static void
-vfs_dir_load(VFSDir* dir)
+vfs_dir_load(VFSDir* dir, bool speculative)
 {
     if (G_LIKELY(dir->path))
     {
         dir->disp_path = g_filename_display_name(dir->path);
-        dir->task = vfs_async_task_new((VFSAsyncFunc)vfs_dir_load_thread, dir);
+        dir->task = vfs_async_task_new(
+            (VFSAsyncFunc)(speculative ? vfs_dir_prefetch_thread : vfs_dir_load_thread),
+            dir);
         g_signal_connect(dir->task, "finish", G_CALLBACK(on_list_task_finished), dir);
         vfs_async_task_execute(dir->task);
     }
 }
 
+static void
+vfs_dir_insert_loaded_file(VFSDir* dir, VFSFileInfo* file, bool provisional_mime)
+{
+    vfs_dir_lock(dir);
+    dir->file_list = g_list_prepend(dir->file_list, file);
+    ++dir->n_files;
+    if (provisional_mime)
+        dir->sniff_files.push_back(vfs_file_info_ref(file));
+    vfs_dir_unlock(dir);
+}
+
+static void
+vfs_dir_add_loaded_file(VFSDir* dir, VFSFileInfo* file, const char* full_path,
+                        bool provisional_mime)
+{
+    /* Special processing for desktop directory */
+    vfs_file_info_load_special_info(file, full_path);
+
+    vfs_dir_insert_loaded_file(dir, file, provisional_mime);
+}
+
+/* nullptr if the file is gone */
+static VFSFileInfo*
+vfs_dir_stat_file(const char* full_path, const char* file_name, bool* provisional_mime)
+{
+    struct stat file_stat;
+    if (G_UNLIKELY(lstat(full_path, &file_stat) != 0))
+        return nullptr;
+
+    VFSFileInfo* file = vfs_file_info_new();
+    *provisional_mime =
+        vfs_file_info_get_with_stat(file, full_path, file_name, &file_stat, nullptr);
+    return file;
+}
+
+static void
+vfs_dir_load_file(VFSDir* dir, const char* file_name)
+{
+    char* full_path = g_build_filename(dir->path, file_name, nullptr);
+    if (!full_path)
+        return;
+
+    bool provisional;
+    VFSFileInfo* file = vfs_dir_stat_file(full_path, file_name, &provisional);
+    if (G_LIKELY(file))
+        vfs_dir_add_loaded_file(dir, file, full_path, provisional);
+    g_free(full_path);
+}
+
+static void
+vfs_dir_load_stat(const char* file_name, struct stat* file_stat, void* user_data)
+{
+    VFSDir* dir = static_cast<VFSDir*>(user_data);
+    char* full_path = g_build_filename(dir->path, file_name, nullptr);
+    if (!full_path)
+        return;
+
+    VFSFileInfo* file = vfs_file_info_new();
+    bool provisional = vfs_file_info_get_with_stat(file, full_path, file_name, file_stat, nullptr);
+    vfs_dir_add_loaded_file(dir, file, full_path, provisional);
+    g_free(full_path);
+}
+
+static void
+vfs_dir_load_snapshot_entry(const char* file_name, struct stat* file_stat, const char* mime_type,
+                            bool mime_from_content, MimeTextCheck text_check, void* user_data)
+{
+    VFSDir* dir = static_cast<VFSDir*>(user_data);
+    char* full_path = g_build_filename(dir->path, file_name, nullptr);
+    if (!full_path)
+        return;
+
+    VFSFileInfo* file = vfs_file_info_new();
+    vfs_file_info_get_with_stat(file, full_path, file_name, file_stat, mime_type);
+    file->mime_from_content = mime_from_content;
+    file->text_check = text_check;
+    vfs_dir_add_loaded_file(dir, file, full_path, false);
+    g_free(full_path);
+}
+
+/* Shared by the load workers. Desktop entries get their icons from the
+ * GTK icon theme, which must not be used from the workers, so they are
+ * handed back and finished by the load thread. */
+struct VFSDirLoadPool
+{
+    struct DesktopFile
+    {
+        VFSFileInfo* file;
+        std::string full_path;
+        bool provisional_mime;
+    };
+
+    VFSDir* dir;
+    std::mutex lock;
+    std::vector<DesktopFile> desktop_files;
+};
+
+static void
+vfs_dir_load_worker(char* file_name, VFSDirLoadPool* load)
+{
+    VFSDir* dir = load->dir;
+    char* full_path;
+    if (!vfs_async_task_is_cancelled(dir->task) &&
+        (full_path = g_build_filename(dir->path, file_name, nullptr)))
+    {
+        bool provisional;
+        VFSFileInfo* file = vfs_dir_stat_file(full_path, file_name, &provisional);
+        if (G_UNLIKELY(file && g_str_has_suffix(file_name, ".desktop")))
+        {
+            std::lock_guard<std::mutex> lock(load->lock);
+            load->desktop_files.push_back({file, full_path, provisional});
+        }
+        else if (G_LIKELY(file))
+            vfs_dir_insert_loaded_file(dir, file, provisional);
+        g_free(full_path);
+    }
+    g_free(file_name);
+}
+
 static void*
 vfs_dir_load_thread(VFSAsyncTask* task, VFSDir* dir)
 {
     (void)task;
     const char* file_name;
-    char* full_path;
 
     dir->file_listed = false;
     dir->load_complete = false;
@@ -615,49 +980,356 @@ vfs_dir_load_thread(VFSAsyncTask* task, VFSDir* dir)
     {
         /* Install file alteration monitor */
         dir->monitor = vfs_file_monitor_add(dir->path, vfs_dir_monitor_callback, dir);
+        dir->monitor_error = dir->monitor ? 0 : errno;
+
+        /* Reuse the listing saved when this dir was last closed,
+         * it is revalidated in the background once listed */
+        if (vfs_dir_snapshot_enabled() &&
+            vfs_dir_snapshot_load(dir->path,
+                                  vfs_dir_load_snapshot_entry,
+                                  dir,
+                                  &dir->xhidden_count))
+        {
+            dir->from_snapshot = true;
+            return nullptr;
+        }
 
         GDir* dir_content = g_dir_open(dir->path, 0, nullptr);
 
         if (dir_content)
         {
             // MOD  dir contains .hidden file?
-            char* hidden = gethidden(dir->path);
+            GHashTable* hidden = vfs_dir_get_hidden(dir);
+
+            /* On network filesystems every lstat is a round trip, so
+             * fan the per-entry work out instead of issuing them one at a time */
+            GThreadPool* pool = nullptr;
+            VFSDirLoadPool load;
+            load.dir = dir;
+            if (dir->parallel_load)
+                pool = g_thread_pool_new((GFunc)vfs_dir_load_worker,
+                                         &load,
+                                         VFS_DIR_LOAD_WORKERS,
+                                         false,
+                                         nullptr);
+
+            /* Otherwise stat in batches relative to the dir fd, submitted
+             * through io_uring when the kernel supports it */
+            int dir_fd = -1;
+            VFSStatxBatch* batch = nullptr;
+            if (!pool && (dir_fd = open(dir->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) != -1)
+                batch = vfs_statx_batch_new(dir_fd, vfs_dir_load_stat, dir);
 
             while (!vfs_async_task_is_cancelled(dir->task) &&
                    (file_name = g_dir_read_name(dir_content)))
             {
-                full_path = g_build_filename(dir->path, file_name, nullptr);
-                if (!full_path)
-                    continue;
-
                 // MOD ignore if in .hidden
-                if (hidden && ishidden(hidden, file_name))
+                if (hidden && g_hash_table_contains(hidden, file_name))
                 {
                     dir->xhidden_count++;
                     continue;
                 }
-                VFSFileInfo* file = vfs_file_info_new();
-                if (G_LIKELY(vfs_file_info_get(file, full_path, file_name)))
-                {
-                    vfs_dir_lock(dir);
 
-                    /* Special processing for desktop directory */
-                    vfs_file_info_load_special_info(file, full_path);
-
-                    dir->file_list = g_list_prepend(dir->file_list, file);
-                    vfs_dir_unlock(dir);
-                    ++dir->n_files;
-                }
+                if (pool)
+                    g_thread_pool_push(pool, g_strdup(file_name), nullptr);
+                else if (batch)
+                    vfs_statx_batch_add(batch, file_name);
                 else
+                    vfs_dir_load_file(dir, file_name);
+            }
+
+            /* wait for all queued entries */
+            if (pool)
+            {
+                g_thread_pool_free(pool, false, true);
+                for (VFSDirLoadPool::DesktopFile& desktop: load.desktop_files)
                 {
-                    vfs_file_info_unref(file);
+                    if (vfs_async_task_is_cancelled(dir->task))
+                        vfs_file_info_unref(desktop.file);
+                    else
+                        vfs_dir_add_loaded_file(dir,
+                                                desktop.file,
+                                                desktop.full_path.c_str(),
+                                                desktop.provisional_mime);
                 }
-                g_free(full_path);
             }
+            if (batch)
+            {
+                if (!vfs_async_task_is_cancelled(dir->task))
+                    vfs_statx_batch_flush(batch);
+                vfs_statx_batch_free(batch);
+            }
+            if (dir_fd != -1)
+                close(dir_fd);
+
             g_dir_close(dir_content);
             if (hidden)
-                g_free(hidden);
+                g_hash_table_unref(hidden);
+        }
+    }
+    return nullptr;
+}
+
+static void*
+vfs_dir_prefetch_thread(VFSAsyncTask* task, VFSDir* dir)
+{
+    /* A guess must not compete with what the user is doing. On Linux the
+     * nice value is per thread, and this thread only lives for the load. */
+    setpriority(PRIO_PROCESS, 0, 19);
+
+    struct stat dir_stat;
+    if (stat(dir->path, &dir_stat) != 0 || !S_ISDIR(dir_stat.st_mode))
+        return nullptr;
+    return vfs_dir_load_thread(task, dir);
+}
+
+static void*
+vfs_dir_revalidate_thread(VFSAsyncTask* task, VFSDir* dir)
+{
+    struct ListedFile
+    {
+        mode_t mode;
+        off_t size;
+        std::time_t mtime;
+        uid_t uid;
+        gid_t gid;
+    };
+    std::unordered_map<std::string, ListedFile> listed;
+
+    vfs_dir_lock(dir);
+    for (GList* l = dir->file_list; l; l = l->next)
+    {
+        VFSFileInfo* file = static_cast<VFSFileInfo*>(l->data);
+        if (file->name)
+            listed.emplace(file->name,
+                           ListedFile{file->mode, file->size, file->mtime, file->uid, file->gid});
+    }
+    vfs_dir_unlock(dir);
+
+    GDir* dir_content = g_dir_open(dir->path, 0, nullptr);
+    if (!dir_content)
+        return nullptr;
+
+    VFSDirRevalidation* result = new VFSDirRevalidation;
+    GHashTable* hidden = vfs_dir_get_hidden(dir);
+    const char* file_name;
+    while (!vfs_async_task_is_cancelled(task) && (file_name = g_dir_read_name(dir_content)))
+    {
+        if (hidden && g_hash_table_contains(hidden, file_name))
+        {
+            result->xhidden_count++;
+            continue;
+        }
+
+        auto it = listed.find(file_name);
+        if (it == listed.end())
+        {
+            result->created.emplace_back(file_name);
+            continue;
+        }
+
+        char* full_path = g_build_filename(dir->path, file_name, nullptr);
+        struct stat file_stat;
+        if (lstat(full_path, &file_stat) == 0 &&
+            (file_stat.st_mode != it->second.mode || file_stat.st_size != it->second.size ||
+             file_stat.st_mtime != it->second.mtime || file_stat.st_uid != it->second.uid ||
+             file_stat.st_gid != it->second.gid))
+        {
+            result->changed.emplace_back(file_name);
+        }
+        g_free(full_path);
+        listed.erase(it);
+    }
+    g_dir_close(dir_content);
+    if (hidden)
+        g_hash_table_unref(hidden);
+
+    // only a complete pass can tell which files are gone
+    if (!vfs_async_task_is_cancelled(task))
+    {
+        for (const auto& it: listed)
+            result->deleted.emplace_back(it.first);
+    }
+    return result;
+}
+
+/* apply a batch of sniffed mime types in the main thread */
+static bool
+on_sniff_timer(VFSDir* dir)
+{
+    std::vector<VFSSniffedFile> sniffed;
+    std::vector<VFSFileInfo*> changed;
+
+    vfs_dir_lock(dir);
+    sniffed.swap(dir->sniffed);
+    dir->sniff_timer = 0;
+    for (VFSSniffedFile& result: sniffed)
+    {
+        VFSFileInfo* file = result.file;
+        // update_file_info() already redid a file changed meanwhile
+        if (file->mtime != result.checked_mtime || file->size != result.checked_size ||
+            !file->mime_type ||
+            result.checked_mime_type != vfs_mime_type_get_type(file->mime_type))
+        {
+            vfs_file_info_unref(file);
+            continue;
+        }
+
+        file->mime_from_content = result.from_content;
+        if (result.text != MIME_TEXT_UNCHECKED)
+            file->text_check = result.text;
+        if (file->mime_type &&
+            strcmp(vfs_mime_type_get_type(file->mime_type), result.mime_type.c_str()))
+        {
+            vfs_mime_type_unref(file->mime_type);
+            file->mime_type = vfs_mime_type_get_from_type(result.mime_type.c_str());
+            changed.push_back(file);
         }
+        else
+            vfs_file_info_unref(file);
+    }
+    vfs_dir_unlock(dir);
+
+    for (VFSFileInfo* file: changed)
+    {
+        g_signal_emit(dir, signals[FILE_CHANGED_SIGNAL], 0, file);
+        vfs_file_info_unref(file);
+    }
+    return false;
+}
+
+/* called from the sniff and retype threads, takes over the reference to result.file */
+static void
+vfs_dir_queue_sniffed(VFSDir* dir, VFSSniffedFile&& result)
+{
+    vfs_dir_lock(dir);
+    dir->sniffed.push_back(std::move(result));
+    if (!dir->sniff_timer)
+        dir->sniff_timer = g_timeout_add_full(G_PRIORITY_LOW,
+                                              VFS_DIR_SNIFF_INTERVAL,
+                                              (GSourceFunc)on_sniff_timer,
+                                              dir,
+                                              nullptr);
+    vfs_dir_unlock(dir);
+}
+
+static void*
+vfs_dir_sniff_thread(VFSAsyncTask* task, VFSDir* dir)
+{
+    struct SniffFile
+    {
+        VFSFileInfo* file;
+        std::string name;
+        std::time_t mtime;
+        off_t size;
+        std::string mime_type;
+    };
+
+    // copy the names, update_file_info() can briefly take file->name away
+    std::vector<SniffFile> files;
+    vfs_dir_lock(dir);
+    for (VFSFileInfo* file: dir->sniff_files)
+    {
+        if (file->name && file->mime_type)
+            files.push_back({file,
+                             file->name,
+                             file->mtime,
+                             file->size,
+                             vfs_mime_type_get_type(file->mime_type)});
+        else
+            vfs_file_info_unref(file);
+    }
+    dir->sniff_files.clear();
+    vfs_dir_unlock(dir);
+
+    for (SniffFile& entry: files)
+    {
+        if (vfs_async_task_is_cancelled(task))
+        {
+            vfs_file_info_unref(entry.file);
+            continue;
+        }
+
+        char* full_path = g_build_filename(dir->path, entry.name.c_str(), nullptr);
+        MimeTextCheck text;
+        const char* type =
+            mime_type_get_by_file_text(full_path, nullptr, entry.name.c_str(), &text);
+        g_free(full_path);
+
+        vfs_dir_queue_sniffed(
+            dir,
+            {entry.file, type, true, text, entry.mtime, entry.size, std::move(entry.mime_type)});
+    }
+    return nullptr;
+}
+
+/* After the mime database changed, only the names are looked up again.
+ * Types detected from content are still valid unless the magic rules changed. */
+static void*
+vfs_dir_retype_thread(VFSAsyncTask* task, VFSDir* dir)
+{
+    struct RetypeFile
+    {
+        VFSFileInfo* file;
+        std::string name;
+        std::string mime_type;
+        mode_t mode;
+        off_t size;
+        std::time_t mtime;
+        bool from_content;
+    };
+
+    std::vector<RetypeFile> files;
+    vfs_dir_lock(dir);
+    const bool retype_content = dir->retype_content;
+    files.reserve(dir->n_files);
+    for (GList* l = dir->file_list; l; l = l->next)
+    {
+        VFSFileInfo* file = static_cast<VFSFileInfo*>(l->data);
+        if (file->name && file->mime_type && !S_ISDIR(file->mode))
+            files.push_back({vfs_file_info_ref(file),
+                             file->name,
+                             vfs_mime_type_get_type(file->mime_type),
+                             file->mode,
+                             file->size,
+                             file->mtime,
+                             file->mime_from_content});
+    }
+    vfs_dir_unlock(dir);
+
+    for (RetypeFile& entry: files)
+    {
+        if (vfs_async_task_is_cancelled(task))
+        {
+            vfs_file_info_unref(entry.file);
+            continue;
+        }
+
+        struct stat file_stat;
+        file_stat.st_mode = entry.mode;
+        file_stat.st_size = entry.size;
+        char* full_path = g_build_filename(dir->path, entry.name.c_str(), nullptr);
+        const char* type =
+            mime_type_get_by_file_no_content(full_path, &file_stat, entry.name.c_str());
+        const bool from_content = !type;
+        MimeTextCheck text = MIME_TEXT_UNCHECKED;
+        if (!type && (retype_content || !entry.from_content))
+            type = mime_type_get_by_file_text(full_path, &file_stat, entry.name.c_str(), &text);
+        g_free(full_path);
+
+        if (!type || (entry.mime_type == type && entry.from_content == from_content))
+        {
+            vfs_file_info_unref(entry.file);
+            continue;
+        }
+        vfs_dir_queue_sniffed(dir,
+                              {entry.file,
+                               type,
+                               from_content,
+                               text,
+                               entry.mtime,
+                               entry.size,
+                               std::move(entry.mime_type)});
     }
     return nullptr;
 }
@@ -813,6 +1485,10 @@ vfs_dir_monitor_callback(VFSFileMonitor* fm, VFSFileMonitorEvent event, const ch
     (void)fm;
     VFSDir* dir = static_cast<VFSDir*>(user_data);
 
+    // the cached .hidden set is stale, reread it on the next load
+    if (G_UNLIKELY(!strcmp(file_name, ".hidden")))
+        vfs_dir_invalidate_hidden(dir);
+
     switch (event)
     {
         case VFS_FILE_MONITOR_CREATE:
@@ -866,6 +1542,115 @@ on_theme_changed(GtkIconTheme* icon_theme, void* user_data)
     g_hash_table_foreach(dir_hash, (GHFunc)reload_icons, nullptr);
 }
 
+static unsigned int
+inotify_watch_budget()
+{
+    static unsigned int budget = 0;
+    if (budget == 0)
+    {
+        // leave most watches to open dirs and other programs
+        unsigned long max_watches = 8192;
+        std::ifstream file("/proc/sys/fs/inotify/max_user_watches");
+        file >> max_watches;
+        budget = std::clamp(max_watches / 16, 1UL, (unsigned long)VFS_DIR_RETAIN_MAX);
+    }
+    return budget;
+}
+
+/* rough heap usage of a loaded dir */
+static uint64_t
+vfs_dir_mem_size(VFSDir* dir)
+{
+    uint64_t size = sizeof(VFSDir);
+    vfs_dir_lock(dir);
+    for (GList* l = dir->file_list; l; l = l->next)
+    {
+        VFSFileInfo* file = static_cast<VFSFileInfo*>(l->data);
+        size += sizeof(GList) + sizeof(VFSFileInfo);
+        if (file->name)
+            size += strlen(file->name) * 4; // name, disp_name and collate keys
+        if (file->big_thumbnail)
+            size += gdk_pixbuf_get_byte_length(file->big_thumbnail);
+        if (file->small_thumbnail)
+            size += gdk_pixbuf_get_byte_length(file->small_thumbnail);
+    }
+    vfs_dir_unlock(dir);
+    return size;
+}
+
+/*
+ * Drop the least recently used closed dirs until the remaining ones fit
+ * in max_bytes and max_count. Dirs still shown somewhere are not counted,
+ * they stay loaded regardless.
+ */
+static void
+vfs_dir_trim_retained(uint64_t max_bytes, unsigned int max_count)
+{
+    std::vector<VFSDir*> evicted;
+    uint64_t used = 0;
+    unsigned int n_closed = 0;
+
+    for (auto it = retained_dirs.begin(); it != retained_dirs.end();)
+    {
+        VFSDir* dir = *it;
+        if (G_OBJECT(dir)->ref_count > 1)
+        {
+            ++it;
+            continue;
+        }
+
+        // a closed dir that is not monitored would go stale
+        const bool stale = dir->load_complete && !dir->monitor;
+        if (!stale)
+        {
+            used += vfs_dir_mem_size(dir);
+            ++n_closed;
+        }
+        if (stale || used > max_bytes || n_closed > max_count)
+        {
+            evicted.push_back(dir);
+            it = retained_dirs.erase(it);
+        }
+        else
+            ++it;
+    }
+
+    // finalizing a dir may change dir_hash, so do it after the walk
+    for (VFSDir* dir: evicted)
+        g_object_unref(dir);
+}
+
+/* Drop the least recently used closed dir other than keep,
+ * returns false if there is none left */
+static bool
+vfs_dir_evict_retained(VFSDir* keep)
+{
+    for (auto it = retained_dirs.rbegin(); it != retained_dirs.rend(); ++it)
+    {
+        VFSDir* dir = *it;
+        if (dir == keep || G_OBJECT(dir)->ref_count > 1)
+            continue;
+        retained_dirs.erase(std::next(it).base());
+        g_object_unref(dir);
+        return true;
+    }
+    return false;
+}
+
+/* mark dir as most recently used and keep it loaded after it is closed */
+static void
+vfs_dir_retain(VFSDir* dir)
+{
+    auto it = std::find(retained_dirs.begin(), retained_dirs.end(), dir);
+    if (it != retained_dirs.end())
+        std::rotate(retained_dirs.begin(), it, it + 1);
+    else if (!dir->avoid_changes && config_settings.dir_cache_size > 0)
+        retained_dirs.insert(retained_dirs.begin(), VFS_DIR(g_object_ref(dir)));
+
+    vfs_dir_trim_retained((uint64_t)std::max(config_settings.dir_cache_size, 0) << 20,
+                          inotify_watch_budget());
+}
+
 VFSDir*
 vfs_dir_get_by_path_soft(const char* path)
 {
@@ -878,13 +1663,11 @@ vfs_dir_get_by_path_soft(const char* path)
     return dir;
 }
 
-VFSDir*
-vfs_dir_get_by_path(const char* path)
+static VFSDir*
+vfs_dir_open(const char* path, bool speculative)
 {
     VFSDir* dir = nullptr;
 
-    g_return_val_if_fail(G_UNLIKELY(path), nullptr);
-
     if (G_UNLIKELY(!dir_hash))
     {
         dir_hash = g_hash_table_new_full(g_str_hash, g_str_equal, nullptr, nullptr);
@@ -900,47 +1683,131 @@ vfs_dir_get_by_path(const char* path)
     }
 
     if (G_UNLIKELY(!mime_cb))
+    {
         mime_cb = vfs_mime_type_add_reload_cb(on_mime_type_reload, nullptr);
+        mime_magic_hash = mime_type_get_magic_hash();
+    }
 
     if (dir)
     {
         g_object_ref(dir);
+        if (G_UNLIKELY(dir->volume_unchecked && !speculative))
+            vfs_dir_check_volume(dir);
     }
     else
     {
-        dir = vfs_dir_new(path);
-        vfs_dir_load(dir); /* asynchronous operation */
+        dir = vfs_dir_new(path, speculative);
+        vfs_dir_load(dir, speculative); /* asynchronous operation */
         g_hash_table_insert(dir_hash, (void*)dir->path, (void*)dir);
     }
     return dir;
 }
 
-static void
-reload_mime_type(char* key, VFSDir* dir, void* user_data)
+VFSDir*
+vfs_dir_get_by_path(const char* path)
+{
+    g_return_val_if_fail(G_UNLIKELY(path), nullptr);
+
+    VFSDir* dir = vfs_dir_open(path, false);
+    vfs_dir_retain(dir);
+    return dir;
+}
+
+static bool
+on_prefetch_timer(void* user_data)
 {
-    (void)key;
     (void)user_data;
-    GList* l;
-    VFSFileInfo* file;
+    prefetch_timer = 0;
+    // whether it is a dir at all is checked by the loading thread
+    if (prefetch_path && !prefetch_dir)
+        prefetch_dir = vfs_dir_open(prefetch_path, true);
+    return false;
+}
 
-    if (G_UNLIKELY(!dir || !dir->file_list))
+/* Dropping the last ref of a dir with a task running would wait for its
+ * thread, so the dir is taken out of dir_hash, its tasks are asked to stop,
+ * and vfs_dir_prefetch_release() lets it go once the last one is done. */
+static void
+vfs_dir_prefetch_drop(VFSDir* dir)
+{
+    VFSAsyncTask* tasks[] = {dir->task, dir->revalidate_task, dir->sniff_task, dir->retype_task};
+    bool busy = false;
+    for (VFSAsyncTask* task: tasks)
+        busy = busy || task;
+    if (G_OBJECT(dir)->ref_count > 1 || !busy)
+    {
+        g_object_unref(dir);
         return;
-    vfs_dir_lock(dir);
-    for (l = dir->file_list; l; l = l->next)
+    }
+
+    dir->prefetch_dropped = true;
+    g_hash_table_remove(dir_hash, dir->path);
+    for (VFSAsyncTask* task: tasks)
     {
-        file = static_cast<VFSFileInfo*>(l->data);
-        char* full_path = g_build_filename(dir->path, vfs_file_info_get_name(file), nullptr);
-        vfs_file_info_reload_mime_type(file, full_path);
-        // LOG_DEBUG("reload {}", full_path);
-        g_free(full_path);
+        if (task)
+            vfs_async_task_request_cancel(task);
     }
+}
 
-    for (l = dir->file_list; l; l = l->next)
+void
+vfs_dir_prefetch(const char* path)
+{
+    if (path && prefetch_path && !strcmp(path, prefetch_path))
+        return;
+
+    /* Focus moved on. If nothing else opened the speculative dir,
+     * its loading thread is cancelled. */
+    if (prefetch_timer)
     {
-        file = static_cast<VFSFileInfo*>(l->data);
-        g_signal_emit(dir, signals[FILE_CHANGED_SIGNAL], 0, file);
+        g_source_remove(prefetch_timer);
+        prefetch_timer = 0;
     }
-    vfs_dir_unlock(dir);
+    if (prefetch_dir)
+    {
+        vfs_dir_prefetch_drop(prefetch_dir);
+        prefetch_dir = nullptr;
+    }
+    g_free(prefetch_path);
+    prefetch_path = nullptr;
+
+    if (!path || path[0] != '/')
+        return;
+    // already loaded
+    if (dir_hash && g_hash_table_lookup(dir_hash, path))
+        return;
+
+    prefetch_path = g_strdup(path);
+    prefetch_timer = g_timeout_add_full(G_PRIORITY_LOW,
+                                        VFS_DIR_PREFETCH_DELAY,
+                                        (GSourceFunc)on_prefetch_timer,
+                                        nullptr,
+                                        nullptr);
+}
+
+static void
+reload_mime_type(char* key, VFSDir* dir, bool* magic_changed)
+{
+    (void)key;
+
+    if (G_UNLIKELY(!dir || !dir->file_list))
+        return;
+
+    // start over with the new database, a cancelled pass is not finished
+    if (dir->retype_task)
+    {
+        g_signal_handlers_disconnect_by_func(dir->retype_task,
+                                             (void*)on_retype_task_finished,
+                                             dir);
+        vfs_async_task_cancel(dir->retype_task);
+        g_object_unref(dir->retype_task);
+        dir->retype_task = nullptr;
+    }
+    if (*magic_changed)
+        dir->retype_content = true;
+
+    dir->retype_task = vfs_async_task_new((VFSAsyncFunc)vfs_dir_retype_thread, dir);
+    g_signal_connect(dir->retype_task, "finish", G_CALLBACK(on_retype_task_finished), dir);
+    vfs_async_task_execute(dir->retype_task);
 }
 
 static void
@@ -950,7 +1817,10 @@ on_mime_type_reload(void* user_data)
     if (!dir_hash)
         return;
     // LOG_DEBUG("reload mime-type");
-    g_hash_table_foreach(dir_hash, (GHFunc)reload_mime_type, nullptr);
+    const uint64_t magic_hash = mime_type_get_magic_hash();
+    bool magic_changed = magic_hash != mime_magic_hash;
+    mime_magic_hash = magic_hash;
+    g_hash_table_foreach(dir_hash, (GHFunc)reload_mime_type, &magic_changed);
 }
 
 void
@@ -12,14 +12,33 @@
 
 #pragma once
 
+#include <string>
 #include <vector>
 
+#include <ctime>
+
 #include <glib.h>
 
 #include "vfs/vfs-file-monitor.hxx"
 #include "vfs/vfs-file-info.hxx"
 #include "vfs/vfs-async-task.hxx"
 
+/* mime type found by checking the content of a file,
+ * or by checking it again after the mime database changed */
+struct VFSSniffedFile
+{
+    VFSFileInfo* file;
+    std::string mime_type;
+    bool from_content;
+    MimeTextCheck text; /* content checked for text while sniffing */
+
+    /* the file when it was picked for checking, if it changed since
+     * then the result is stale and dropped */
+    std::time_t checked_mtime;
+    off_t checked_size;
+    std::string checked_mime_type;
+};
+
 #define VFS_TYPE_DIR (vfs_dir_get_type())
 #define VFS_DIR(obj) (reinterpret_cast<VFSDir*>(obj))
 
@@ -34,21 +53,38 @@ struct VFSDir
 
     /*<private>*/
     VFSFileMonitor* monitor;
+    int monitor_error; /* errno of a failed monitor, ENOSPC when out of inotify watches */
 
     GMutex* mutex; /* Used to guard file_list */
 
     VFSAsyncTask* task;
+    VFSAsyncTask* revalidate_task; // checks a listing loaded from a snapshot
+    VFSAsyncTask* sniff_task;      // checks content of files with a provisional mime type
+    VFSAsyncTask* retype_task;     // checks mime types again after the mime database changed
     bool file_listed : 1;
     bool load_complete : 1;
     bool cancel : 1;
     bool show_hidden : 1;
     bool avoid_changes : 1; // sfm
+    bool parallel_load : 1; // stat entries in a worker pool (network filesystems)
+    bool from_snapshot : 1; // listing was loaded from the on-disk snapshot cache
+    bool retype_content : 1; // magic rules changed, recheck types detected from content
+    bool volume_unchecked : 1; // prefetched, volume flags are looked up once it is opened
+    bool prefetch_dropped : 1; // prefetch given up while loading, no longer in dir_hash
 
     struct VFSThumbnailLoader* thumbnail_loader;
 
     std::vector<VFSFileInfo*> changed_files;
     GSList* created_files; // MOD
     long xhidden_count;    // MOD
+
+    GHashTable* hidden_files;   // names listed in .hidden, parsed once
+    bool hidden_loaded;         // hidden_files is valid, nullptr if there is no .hidden
+    unsigned int hidden_serial; // bumped when .hidden changes
+
+    std::vector<VFSFileInfo*> sniff_files; // listed with a provisional mime type
+    std::vector<VFSSniffedFile> sniffed;   // content checked, waiting for sniff_timer
+    unsigned int sniff_timer;
 };
 
 struct VFSDirClass
@@ -73,6 +109,10 @@ GType vfs_dir_get_type();
 VFSDir* vfs_dir_get_by_path(const char* path);
 VFSDir* vfs_dir_get_by_path_soft(const char* path);
 
+/* Speculatively load path because it is likely to be opened next.
+ * A new call, or nullptr, cancels the previous one unless it was opened meanwhile. */
+void vfs_dir_prefetch(const char* path);
+
 bool vfs_dir_is_file_listed(VFSDir* dir);
 
 void vfs_dir_unload_thumbnails(VFSDir* dir, bool is_big);
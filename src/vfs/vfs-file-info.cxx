@@ -13,9 +13,6 @@
 #include <string>
 #include <vector>
 
-#include <grp.h>
-#include <pwd.h>
-
 #include "vendor/ztd/ztd.hxx"
 
 #include "logger.hxx"
@@ -25,6 +22,7 @@
 #include "vfs/vfs-thumbnail-loader.hxx"
 #include "vfs/vfs-utils.hxx"
 #include "vfs/vfs-user-dir.hxx"
+#include "vfs/vfs-owner-cache.hxx"
 
 #include "vfs/vfs-file-info.hxx"
 
@@ -61,16 +59,9 @@ vfs_file_info_clear(VFSFileInfo* fi)
         g_free(fi->collate_icase_key);
         fi->collate_icase_key = nullptr;
     }
-    if (fi->disp_size)
-    {
-        g_free(fi->disp_size);
-        fi->disp_size = nullptr;
-    }
-    if (fi->disp_owner)
-    {
-        g_free(fi->disp_owner);
-        fi->disp_owner = nullptr;
-    }
+    // interned, only forget them
+    fi->disp_size = nullptr;
+    fi->disp_owner = nullptr;
     if (fi->disp_mtime)
     {
         g_free(fi->disp_mtime);
@@ -95,6 +86,8 @@ vfs_file_info_clear(VFSFileInfo* fi)
         fi->mime_type = nullptr;
     }
     fi->flags = VFS_FILE_INFO_NONE;
+    fi->mime_from_content = false;
+    fi->text_check = MIME_TEXT_UNCHECKED;
 }
 
 VFSFileInfo*
@@ -115,6 +108,54 @@ vfs_file_info_unref(VFSFileInfo* fi)
     }
 }
 
+static bool
+vfs_file_info_set_stat(VFSFileInfo* fi, const char* file_path, struct stat* file_stat,
+                       const char* mime_type, bool read_content)
+{
+    /* This is time-consuming but can save much memory */
+    fi->mode = file_stat->st_mode;
+    fi->dev = file_stat->st_dev;
+    fi->uid = file_stat->st_uid;
+    fi->gid = file_stat->st_gid;
+    fi->size = file_stat->st_size;
+    // LOG_INFO("size {} {}", fi->name, fi->size);
+    fi->mtime = file_stat->st_mtime;
+    fi->atime = file_stat->st_atime;
+    fi->blksize = file_stat->st_blksize;
+    fi->blocks = file_stat->st_blocks;
+
+    if (G_LIKELY(g_utf8_validate(fi->name, -1, nullptr)))
+    {
+        fi->disp_name = fi->name; /* Don't duplicate the name and save memory */
+    }
+    else
+    {
+        fi->disp_name = g_filename_display_name(fi->name);
+    }
+    // sfm collate keys are created on first use by a name sort
+
+    if (mime_type)
+        fi->mime_type = vfs_mime_type_get_from_type(mime_type);
+    else if (!(fi->mime_type =
+                   vfs_mime_type_get_from_file_no_content(file_path, fi->disp_name, file_stat)))
+    {
+        fi->mime_from_content = true;
+        if (read_content)
+            fi->mime_type = vfs_mime_type_get_from_type(
+                mime_type_get_by_file_text(file_path, file_stat, fi->disp_name, &fi->text_check));
+        else
+        {
+            // provisional until the content is checked
+            if (file_stat->st_mode & (S_IXUSR | S_IXGRP | S_IXOTH))
+                fi->mime_type = vfs_mime_type_get_from_type(XDG_MIME_TYPE_EXECUTABLE);
+            else
+                fi->mime_type = vfs_mime_type_get_from_type(XDG_MIME_TYPE_UNKNOWN);
+            return true;
+        }
+    }
+    return false;
+}
+
 bool
 vfs_file_info_get(VFSFileInfo* fi, const char* file_path, const char* base_name)
 {
@@ -128,32 +169,7 @@ vfs_file_info_get(VFSFileInfo* fi, const char* file_path, const char* base_name)
 
     if (lstat(file_path, &file_stat) == 0)
     {
-        /* This is time-consuming but can save much memory */
-        fi->mode = file_stat.st_mode;
-        fi->dev = file_stat.st_dev;
-        fi->uid = file_stat.st_uid;
-        fi->gid = file_stat.st_gid;
-        fi->size = file_stat.st_size;
-        // LOG_INFO("size {} {}", fi->name, fi->size);
-        fi->mtime = file_stat.st_mtime;
-        fi->atime = file_stat.st_atime;
-        fi->blksize = file_stat.st_blksize;
-        fi->blocks = file_stat.st_blocks;
-
-        if (G_LIKELY(g_utf8_validate(fi->name, -1, nullptr)))
-        {
-            fi->disp_name = fi->name; /* Don't duplicate the name and save memory */
-        }
-        else
-        {
-            fi->disp_name = g_filename_display_name(fi->name);
-        }
-        fi->mime_type = vfs_mime_type_get_from_file(file_path, fi->disp_name, &file_stat);
-        // sfm get collate keys
-        fi->collate_key = g_utf8_collate_key_for_filename(fi->disp_name, -1);
-        char* str = g_utf8_casefold(fi->disp_name, -1);
-        fi->collate_icase_key = g_utf8_collate_key_for_filename(str, -1);
-        g_free(str);
+        vfs_file_info_set_stat(fi, file_path, &file_stat, nullptr, true);
         return true;
     }
     else
@@ -161,6 +177,15 @@ vfs_file_info_get(VFSFileInfo* fi, const char* file_path, const char* base_name)
     return false;
 }
 
+bool
+vfs_file_info_get_with_stat(VFSFileInfo* fi, const char* file_path, const char* base_name,
+                            struct stat* file_stat, const char* mime_type)
+{
+    vfs_file_info_clear(fi);
+    fi->name = g_strdup(base_name);
+    return vfs_file_info_set_stat(fi, file_path, file_stat, mime_type, false);
+}
+
 const char*
 vfs_file_info_get_name(VFSFileInfo* fi)
 {
@@ -180,13 +205,48 @@ vfs_file_info_set_disp_name(VFSFileInfo* fi, const char* name)
     if (fi->disp_name && fi->disp_name != fi->name)
         g_free(fi->disp_name);
     fi->disp_name = g_strdup(name);
-    // sfm get new collate keys
+    // sfm drop old collate keys, recreated on next use
     g_free(fi->collate_key);
     g_free(fi->collate_icase_key);
-    fi->collate_key = g_utf8_collate_key_for_filename(fi->disp_name, -1);
-    char* str = g_utf8_casefold(fi->disp_name, -1);
-    fi->collate_icase_key = g_utf8_collate_key_for_filename(str, -1);
-    g_free(str);
+    fi->collate_key = fi->collate_icase_key = nullptr;
+}
+
+/* Only pay for collation when sorting by name actually needs it.
+ * The key is published atomically, so a racing caller just drops its copy. */
+static const char*
+vfs_file_info_collate_key(VFSFileInfo* fi, char** key, bool icase)
+{
+    char* ret = static_cast<char*>(g_atomic_pointer_get(key));
+    if (G_LIKELY(ret))
+        return ret;
+
+    if (icase)
+    {
+        char* str = g_utf8_casefold(fi->disp_name, -1);
+        ret = g_utf8_collate_key_for_filename(str, -1);
+        g_free(str);
+    }
+    else
+        ret = g_utf8_collate_key_for_filename(fi->disp_name, -1);
+
+    if (!g_atomic_pointer_compare_and_exchange(key, nullptr, ret))
+    {
+        g_free(ret);
+        ret = static_cast<char*>(g_atomic_pointer_get(key));
+    }
+    return ret;
+}
+
+const char*
+vfs_file_info_get_collate_key(VFSFileInfo* fi)
+{
+    return vfs_file_info_collate_key(fi, &fi->collate_key, false);
+}
+
+const char*
+vfs_file_info_get_collate_icase_key(VFSFileInfo* fi)
+{
+    return vfs_file_info_collate_key(fi, &fi->collate_icase_key, true);
 }
 
 off_t
@@ -202,7 +262,8 @@ vfs_file_info_get_disp_size(VFSFileInfo* fi)
     {
         char buf[64];
         vfs_file_size_to_string_format(buf, fi->size, true);
-        fi->disp_size = g_strdup(buf);
+        // few distinct values, share them between all files
+        fi->disp_size = g_intern_string(buf);
     }
     return fi->disp_size;
 }
@@ -220,25 +281,6 @@ vfs_file_info_get_mime_type(VFSFileInfo* fi)
     return fi->mime_type;
 }
 
-void
-vfs_file_info_reload_mime_type(VFSFileInfo* fi, const char* full_path)
-{
-    VFSMimeType* old_mime_type;
-    struct stat file_stat;
-
-    /* convert VFSFileInfo to struct stat */
-    /* In current implementation, only st_mode is used in
-       mime-type detection, so let's save some CPU cycles
-       and don't copy unused fields.
-    */
-    file_stat.st_mode = fi->mode;
-
-    old_mime_type = fi->mime_type;
-    fi->mime_type = vfs_mime_type_get_from_file(full_path, fi->name, &file_stat);
-    vfs_file_info_load_special_info(fi, full_path);
-    vfs_mime_type_unref(old_mime_type); /* FIXME: is vfs_mime_type_unref needed ?*/
-}
-
 const char*
 vfs_file_info_get_mime_type_desc(VFSFileInfo* fi)
 {
@@ -269,7 +311,9 @@ vfs_file_info_get_big_icon(VFSFileInfo* fi)
             char* icon_name = nullptr;
             if (fi->big_thumbnail)
             {
-                icon_name = (char*)g_object_steal_data(G_OBJECT(fi->big_thumbnail), "name");
+                // cached icons are shared, leave their name in place
+                icon_name = g_strdup(
+                    (const char*)g_object_get_data(G_OBJECT(fi->big_thumbnail), "name"));
                 g_object_unref(fi->big_thumbnail);
                 fi->big_thumbnail = nullptr;
             }
@@ -319,34 +363,13 @@ vfs_file_info_get_small_thumbnail(VFSFileInfo* fi)
 const char*
 vfs_file_info_get_disp_owner(VFSFileInfo* fi)
 {
-    struct passwd* puser;
-    struct group* pgroup;
-    char uid_str_buf[32];
-    char* user_name;
-    char gid_str_buf[32];
-    char* group_name;
-
-    /* FIXME: user names should be cached */
     if (!fi->disp_owner)
     {
-        puser = getpwuid(fi->uid);
-        if (puser && puser->pw_name && *puser->pw_name)
-            user_name = puser->pw_name;
-        else
-        {
-            g_snprintf(uid_str_buf, sizeof(uid_str_buf), "%d", fi->uid);
-            user_name = uid_str_buf;
-        }
-
-        pgroup = getgrgid(fi->gid);
-        if (pgroup && pgroup->gr_name && *pgroup->gr_name)
-            group_name = pgroup->gr_name;
-        else
-        {
-            g_snprintf(gid_str_buf, sizeof(gid_str_buf), "%d", fi->gid);
-            group_name = gid_str_buf;
-        }
-        fi->disp_owner = g_strdup_printf("%s:%s", user_name, group_name);
+        const std::string owner = fmt::format("{}:{}",
+                                              vfs_owner_cache_user_name(fi->uid),
+                                              vfs_owner_cache_group_name(fi->gid));
+        // few distinct values, share them between all files
+        fi->disp_owner = g_intern_string(owner.c_str());
     }
     return fi->disp_owner;
 }
@@ -604,6 +627,9 @@ vfs_file_info_is_executable(VFSFileInfo* fi, const char* file_path)
 bool
 vfs_file_info_is_text(VFSFileInfo* fi, const char* file_path)
 {
+    // the loader already read the content when it detected the mime type
+    if (fi->text_check != MIME_TEXT_UNCHECKED)
+        return mime_type_is_text_data(fi->mime_type->type, fi->text_check);
     return mime_type_is_text_file(file_path, fi->mime_type->type);
 }
 
@@ -34,31 +34,37 @@ enum VFSFileInfoFlag
 
 struct VFSFileInfo
 {
+    /* Fields are ordered largest first to avoid padding, this
+     * struct is allocated once for every file in a listing. */
+
+    char* name;                 /* real name on file system */
+    char* disp_name;            /* displayed name (in UTF-8) */
+    char* collate_key;          // sfm sort key, created on first use
+    char* collate_icase_key;    // sfm case folded sort key, created on first use
+    const char* disp_size;      /* displayed human-readable file size, interned */
+    const char* disp_owner;     /* displayed owner:group pair, interned */
+    char* disp_mtime;           /* displayed last modification time */
+    VFSMimeType* mime_type;     /* mime type related information */
+    GdkPixbuf* big_thumbnail;   /* thumbnail of the file */
+    GdkPixbuf* small_thumbnail; /* thumbnail of the file */
+
     /* struct stat file_stat; */
     /* Only use some members of struct stat to reduce memory usage */
-    mode_t mode;
     dev_t dev;
-    uid_t uid;
-    gid_t gid;
     off_t size;
     std::time_t mtime;
     std::time_t atime;
     long blksize;
     blkcnt_t blocks;
+    mode_t mode;
+    uid_t uid;
+    gid_t gid;
 
-    char* name;                 /* real name on file system */
-    char* disp_name;            /* displayed name (in UTF-8) */
-    char* collate_key;          // sfm sort key
-    char* collate_icase_key;    // sfm case folded sort key
-    char* disp_size;            /* displayed human-readable file size */
-    char* disp_owner;           /* displayed owner:group pair */
-    char* disp_mtime;           /* displayed last modification time */
-    char disp_perm[12];         /* displayed permission in string form */
-    VFSMimeType* mime_type;     /* mime type related information */
-    GdkPixbuf* big_thumbnail;   /* thumbnail of the file */
-    GdkPixbuf* small_thumbnail; /* thumbnail of the file */
+    char disp_perm[12]; /* displayed permission in string form */
 
-    VFSFileInfoFlag flags; /* if it's a special file */
+    VFSFileInfoFlag flags;    /* if it's a special file */
+    bool mime_from_content;   /* mime type was detected by the magic rules */
+    MimeTextCheck text_check; /* content checked for text while detecting the mime type */
 
     void ref_inc();
     void ref_dec();
@@ -73,12 +79,20 @@ VFSFileInfo* vfs_file_info_ref(VFSFileInfo* fi);
 void vfs_file_info_unref(VFSFileInfo* fi);
 
 bool vfs_file_info_get(VFSFileInfo* fi, const char* file_path, const char* base_name);
+/* same as vfs_file_info_get, using lstat info the caller already has.
+ * mime_type can be nullptr to detect it from name and mode, without reading the file.
+ * Returns true if that mime type is only provisional and the content has to be checked. */
+bool vfs_file_info_get_with_stat(VFSFileInfo* fi, const char* file_path, const char* base_name,
+                                 struct stat* file_stat, const char* mime_type);
 
 const char* vfs_file_info_get_name(VFSFileInfo* fi);
 const char* vfs_file_info_get_disp_name(VFSFileInfo* fi);
 
 void vfs_file_info_set_disp_name(VFSFileInfo* fi, const char* name);
 
+const char* vfs_file_info_get_collate_key(VFSFileInfo* fi);
+const char* vfs_file_info_get_collate_icase_key(VFSFileInfo* fi);
+
 off_t vfs_file_info_get_size(VFSFileInfo* fi);
 const char* vfs_file_info_get_disp_size(VFSFileInfo* fi);
 
@@ -87,7 +101,6 @@ off_t vfs_file_info_get_blocks(VFSFileInfo* fi);
 mode_t vfs_file_info_get_mode(VFSFileInfo* fi);
 
 VFSMimeType* vfs_file_info_get_mime_type(VFSFileInfo* fi);
-void vfs_file_info_reload_mime_type(VFSFileInfo* fi, const char* full_path);
 
 const char* vfs_file_info_get_mime_type_desc(VFSFileInfo* fi);
 
@@ -95,6 +95,63 @@ vfs_file_monitor_init()
     return true;
 }
 
+/* Add the inotify watch of monitor, on failure it is logged,
+ * monitor->wd is negative and errno is kept for the caller */
+static bool
+vfs_file_monitor_watch(VFSFileMonitor* monitor, const char* real_path, const char* path)
+{
+    monitor->wd = inotify_add_watch(vfs_inotify_fd,
+                                    real_path,
+                                    IN_MODIFY | IN_CREATE | IN_DELETE | IN_DELETE_SELF | IN_MOVE |
+                                        IN_MOVE_SELF | IN_UNMOUNT | IN_ATTRIB);
+    if (monitor->wd < 0)
+    {
+        const int error = errno;
+        const char* msg;
+        switch (error)
+        {
+            case EACCES:
+                msg = "EACCES Read access to the given directory is not permitted.";
+                break;
+            case EBADF:
+                msg = "EBADF The given file descriptor is not valid.";
+                break;
+            case EFAULT:
+                msg = "EFAULT Pathname points outside of the process's accessible "
+                      "address space.";
+                break;
+            case EINVAL:
+                msg = "EINVAL The given event mask contains no valid events; "
+                      "or fd is not an inotify file descriptor.";
+                break;
+            case ENOENT:
+                msg = "ENOENT A directory component in pathname does not exist "
+                      "or is a dangling symbolic link.";
+                break;
+            case ENOMEM:
+                msg = "ENOMEM Insufficient kernel memory was available.";
+                break;
+            case ENOSPC:
+                msg = "ENOSPC The user limit on the total number of inotify watches (cat "
+                      "/proc/sys/fs/inotify/max_user_watches) was reached or the kernel failed "
+                      "to allocate a needed resource.";
+                break;
+            default:
+                msg = "??? Unknown error.";
+                break;
+        }
+        LOG_WARN("Failed to add watch on '{}' ('{}'): inotify_add_watch errno {} {}",
+                 real_path,
+                 path,
+                 error,
+                 msg);
+        errno = error;
+        return false;
+    }
+    // LOG_INFO("vfs_file_monitor_add  {} ({}) {}", real_path, path, monitor->wd);
+    return true;
+}
+
 VFSFileMonitor*
 vfs_file_monitor_add(char* path, VFSFileMonitorCallback cb, void* user_data)
 {
@@ -104,7 +161,10 @@ vfs_file_monitor_add(char* path, VFSFileMonitorCallback cb, void* user_data)
     // LOG_INFO("vfs_file_monitor_add  {}", path);
 
     if (!monitor_hash)
+    {
+        errno = EINVAL;
         return nullptr;
+    }
 
     // inotify does not follow symlinks, need to get real path
     if (strlen(path) > PATH_MAX - 1)
@@ -125,59 +185,22 @@ vfs_file_monitor_add(char* path, VFSFileMonitorCallback cb, void* user_data)
     if (!monitor)
     {
         monitor = g_slice_new0(VFSFileMonitor);
+        if (!vfs_file_monitor_watch(monitor, real_path, path))
+        {
+            // not hashed, a later add must not find a monitor without a watch
+            g_slice_free(VFSFileMonitor, monitor);
+            return nullptr;
+        }
         monitor->path = g_strdup(real_path);
 
         monitor->callbacks = g_array_new(false, false, sizeof(VFSFileMonitorCallbackEntry));
         g_hash_table_insert(monitor_hash, monitor->path, monitor);
-
-        monitor->wd = inotify_add_watch(vfs_inotify_fd,
-                                        real_path,
-                                        IN_MODIFY | IN_CREATE | IN_DELETE | IN_DELETE_SELF |
-                                            IN_MOVE | IN_MOVE_SELF | IN_UNMOUNT | IN_ATTRIB);
-        if (monitor->wd < 0)
-        {
-            const char* msg;
-            switch (errno)
-            {
-                case EACCES:
-                    msg = g_strdup("EACCES Read access to the given directory is not permitted.");
-                    break;
-                case EBADF:
-                    msg = g_strdup("EBADF The given file descriptor is not valid.");
-                    break;
-                case EFAULT:
-                    msg = g_strdup("EFAULT Pathname points outside of the process's accessible "
-                                   "address space.");
-                    break;
-                case EINVAL:
-                    msg = g_strdup("EINVAL The given event mask contains no valid events; "
-                                   "or fd is not an inotify file descriptor.");
-                    break;
-                case ENOENT:
-                    msg = g_strdup("ENOENT A directory component in pathname does not exist "
-                                   "or is a dangling symbolic link.");
-                    break;
-                case ENOMEM:
-                    msg = g_strdup("ENOMEM Insufficient kernel memory was available.");
-                    break;
-                case ENOSPC:
-                    msg = g_strdup(
-                        "ENOSPC The user limit on the total number of inotify watches (cat "
-                        "/proc/sys/fs/inotify/max_user_watches) was reached or the kernel failed "
-                        "to allocate a needed resource.");
-                    break;
-                default:
-                    msg = g_strdup("??? Unknown error.");
-                    break;
-            }
-            LOG_WARN("Failed to add watch on '{}' ('{}'): inotify_add_watch errno {} {}",
-                     real_path,
-                     path,
-                     errno,
-                     msg);
+    }
+    else if (monitor->wd < 0)
+    {
+        // lost its watch when inotify was reconnected, it would never fire
+        if (!vfs_file_monitor_watch(monitor, real_path, path))
             return nullptr;
-        }
-        // LOG_INFO("vfs_file_monitor_add  {} ({}) {}", real_path, path, monitor->wd);
     }
 
     if (G_LIKELY(monitor))
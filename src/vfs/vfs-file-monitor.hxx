@@ -65,6 +65,8 @@ bool vfs_file_monitor_init();
  * path: the file/dir to be monitored
  * cb: callback function to be called when file event happens.
  * user_data: user data to be passed to callback function.
+ *
+ * Returns nullptr if the watch can not be added, errno tells why.
  */
 VFSFileMonitor* vfs_file_monitor_add(char* path, VFSFileMonitorCallback cb, void* user_data);
 
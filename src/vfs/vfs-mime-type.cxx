@@ -12,25 +12,56 @@
 
 #include <string>
 #include <filesystem>
+#include <vector>
+#include <algorithm>
+
+#include <atomic>
+#include <mutex>
 
 #include <gtk/gtk.h>
 
 #include "vfs/vfs-mime-type.hxx"
 #include "vfs/vfs-file-monitor.hxx"
 
+#include "mime-type/mime-desc-index.hxx"
+
+#include "vfs/vfs-user-dir.hxx"
+
 #include "vfs/vfs-utils.hxx"
 
 #include "logger.hxx"
 
-static GHashTable* mime_hash = nullptr;
-static GRWLock mime_hash_lock;
+/* Registry of the shared VFSMimeType, read without locking by every
+ * file load. A table is an open addressed array of atomic pointers that
+ * only ever gets entries added, so a reader either sees a complete entry
+ * or an empty slot. Replaced tables (grown or reset by a reload) are
+ * retired, and freed once no lookup is in progress.
+ * Writers are serialized by mime_registry_lock. */
+struct VFSMimeRegistry
+{
+    std::size_t mask;
+    std::size_t used;
+    std::vector<std::atomic<VFSMimeType*>> slots;
+    bool owns_refs; /* false once its entries moved to a grown table */
+};
+
+/* initial number of slots, a power of 2 */
+#define MIME_REGISTRY_SIZE 512
+
+static std::atomic<VFSMimeRegistry*> mime_registry{nullptr};
+static std::mutex mime_registry_lock;
+/* lookups probing a table without the lock */
+static std::atomic<int> mime_registry_readers{0};
+static std::vector<VFSMimeRegistry*> retired_registries;
+static std::atomic<bool> mime_registry_has_retired{false};
 
 static unsigned int reload_callback_id = 0;
 static GList* reload_cb = nullptr;
 
 static int big_icon_size = 32, small_icon_size = 16;
 
-static VFSFileMonitor** mime_caches_monitor = nullptr;
+static std::vector<VFSFileMonitor*> mime_caches_monitor;
+static std::vector<VFSFileMonitor*> apps_dirs_monitor; /* applications dirs and ~/.config */
 
 static unsigned int theme_change_notify = 0;
 
@@ -42,21 +73,114 @@ struct VFSMimeReloadCbEnt
     void* user_data;
 };
 
+static VFSMimeRegistry*
+mime_registry_new(std::size_t size)
+{
+    return new VFSMimeRegistry{size - 1, 0, std::vector<std::atomic<VFSMimeType*>>(size), true};
+}
+
+static void
+mime_registry_free(VFSMimeRegistry* registry)
+{
+    if (registry->owns_refs)
+    {
+        for (std::atomic<VFSMimeType*>& slot: registry->slots)
+        {
+            VFSMimeType* mime_type = slot.load(std::memory_order_relaxed);
+            if (mime_type)
+                vfs_mime_type_unref(mime_type);
+        }
+    }
+    delete registry;
+}
+
+static VFSMimeType*
+mime_registry_find(VFSMimeRegistry* registry, const char* type, std::size_t hash)
+{
+    for (std::size_t i = hash & registry->mask;; i = (i + 1) & registry->mask)
+    {
+        VFSMimeType* mime_type = registry->slots[i].load(std::memory_order_acquire);
+        if (!mime_type || !strcmp(mime_type->type, type))
+            return mime_type;
+    }
+}
+
+/* must hold mime_registry_lock, the registry takes over the ref of mime_type */
+static void
+mime_registry_add(VFSMimeRegistry* registry, VFSMimeType* mime_type, std::size_t hash)
+{
+    std::size_t i = hash & registry->mask;
+    while (registry->slots[i].load(std::memory_order_relaxed))
+        i = (i + 1) & registry->mask;
+    registry->slots[i].store(mime_type, std::memory_order_release);
+    ++registry->used;
+}
+
+/* must hold mime_registry_lock */
+static void
+mime_registry_reclaim()
+{
+    /* A lookup starting after a table was swapped out gets the new one,
+     * so if none is in progress now, none can still be probing a retired
+     * table. Otherwise the last lookup to finish tries again. */
+    if (mime_registry_readers.load() != 0)
+        return;
+    for (VFSMimeRegistry* retired: retired_registries)
+        mime_registry_free(retired);
+    retired_registries.clear();
+    mime_registry_has_retired.store(false);
+}
+
+/* must hold mime_registry_lock, call once mime_registry no longer points to registry */
+static void
+mime_registry_retire(VFSMimeRegistry* registry)
+{
+    retired_registries.push_back(registry);
+    mime_registry_has_retired.store(true);
+    mime_registry_reclaim();
+}
+
+/* must hold mime_registry_lock, keep at most half of the slots in use */
+static VFSMimeRegistry*
+mime_registry_reserve()
+{
+    VFSMimeRegistry* registry = mime_registry.load(std::memory_order_relaxed);
+    if ((registry->used + 1) * 2 <= registry->slots.size())
+        return registry;
+
+    VFSMimeRegistry* grown = mime_registry_new(registry->slots.size() * 2);
+    for (std::atomic<VFSMimeType*>& slot: registry->slots)
+    {
+        VFSMimeType* mime_type = slot.load(std::memory_order_relaxed);
+        if (mime_type)
+            mime_registry_add(grown, mime_type, g_str_hash(mime_type->type));
+    }
+    registry->owns_refs = false;
+    mime_registry.store(grown);
+    mime_registry_retire(registry);
+    return grown;
+}
+
 static bool
 vfs_mime_type_reload(void* user_data)
 {
     (void)user_data;
     GList* l;
     /* FIXME: process mime database reloading properly. */
-    /* Remove all items in the hash table */
+    /* once per burst of changes, update-mime-database writes several files */
+    mime_type_reload();
 
-    g_rw_lock_writer_lock(&mime_hash_lock);
-    g_hash_table_foreach_remove(mime_hash, (GHRFunc)gtk_true, nullptr);
-    g_rw_lock_writer_unlock(&mime_hash_lock);
+    /* Start over with an empty registry */
+    {
+        std::lock_guard<std::mutex> lock(mime_registry_lock);
+        mime_registry_retire(mime_registry.exchange(mime_registry_new(MIME_REGISTRY_SIZE)));
+    }
 
     g_source_remove(reload_callback_id);
     reload_callback_id = 0;
 
+    mime_desc_index_reload();
+
     // LOG_DEBUG("reload mime-types");
 
     /* call all registered callbacks */
@@ -68,27 +192,84 @@ vfs_mime_type_reload(void* user_data)
     return false;
 }
 
+static void on_apps_dir_changed(VFSFileMonitor* fm, VFSFileMonitorEvent event,
+                                const char* file_name, void* user_data);
+
+/* Watch dir, and with subdirs every dir below it, desktop files
+ * in an applications dir can be nested at any depth */
+static void
+apps_dir_monitor_add(std::string dir, bool subdirs)
+{
+    VFSFileMonitor* fm = vfs_file_monitor_add(dir.data(), on_apps_dir_changed, nullptr);
+    if (!fm)
+        return;
+    if (std::find(apps_dirs_monitor.begin(), apps_dirs_monitor.end(), fm) !=
+        apps_dirs_monitor.end())
+    {
+        // reached again through a symlink, keep a single callback
+        vfs_file_monitor_remove(fm, on_apps_dir_changed, nullptr);
+        return;
+    }
+    apps_dirs_monitor.push_back(fm);
+
+    if (!subdirs)
+        return;
+    std::error_code ec;
+    for (const auto& entry: std::filesystem::directory_iterator(dir, ec))
+    {
+        if (entry.is_directory(ec))
+            apps_dir_monitor_add(entry.path(), true);
+    }
+}
+
+static void
+apps_dir_monitor_remove(const std::string& dir)
+{
+    auto it = std::find_if(apps_dirs_monitor.begin(),
+                           apps_dirs_monitor.end(),
+                           [&dir](VFSFileMonitor* fm) { return dir == fm->path; });
+    if (it == apps_dirs_monitor.end())
+        return;
+    vfs_file_monitor_remove(*it, on_apps_dir_changed, nullptr);
+    apps_dirs_monitor.erase(it);
+}
+
+static void
+on_apps_dir_changed(VFSFileMonitor* fm, VFSFileMonitorEvent event, const char* file_name,
+                    void* user_data)
+{
+    (void)user_data;
+    // ~/.config holds much more than mimeapps.list
+    if (!strcmp(fm->path, vfs_user_config_dir()) && g_strcmp0(file_name, "mimeapps.list"))
+        return;
+
+    // follow subdirs of applications dirs as they come and go,
+    // events on the watched dir itself pass its full path
+    if (file_name && file_name[0] && file_name[0] != '/')
+    {
+        const std::string path = vfs_build_path(fm->path, file_name);
+        if (event == VFS_FILE_MONITOR_CREATE && std::filesystem::is_directory(path))
+            apps_dir_monitor_add(path, true);
+        else if (event == VFS_FILE_MONITOR_DELETE)
+            apps_dir_monitor_remove(path);
+    }
+
+    mime_type_actions_reload();
+}
+
 static void
 on_mime_cache_changed(VFSFileMonitor* fm, VFSFileMonitorEvent event, const char* file_name,
                       void* user_data)
 {
     (void)fm;
     (void)file_name;
-    MimeCache* cache = static_cast<MimeCache*>(user_data);
+    (void)user_data;
     switch (event)
     {
         case VFS_FILE_MONITOR_CREATE:
         case VFS_FILE_MONITOR_DELETE:
-            /* NOTE: FAM sometimes generate incorrect "delete" notification for non-existent files.
-             *  So if the cache is not loaded originally (the cache file is non-existent), we skip
-             * it.
-             */
-            if (!cache->buffer)
-                return;
-
-            FMT_FALLTHROUGH;
         case VFS_FILE_MONITOR_CHANGE:
-            mime_cache_reload(cache);
+            // the caches are reloaded by vfs_mime_type_reload()
             // LOG_DEBUG("reload cache: {}", file_name);
             if (reload_callback_id == 0)
                 reload_callback_id = g_idle_add((GSourceFunc)vfs_mime_type_reload, nullptr);
@@ -104,22 +285,33 @@ vfs_mime_type_init()
     mime_type_init();
 
     /* install file alteration monitor for mime-cache */
-    int n_caches;
-    MimeCache** caches = mime_type_get_caches(&n_caches);
-    mime_caches_monitor = g_new0(VFSFileMonitor*, n_caches);
-    int i;
-    for (i = 0; i < n_caches; ++i)
+    for (std::string file: mime_type_get_cache_files())
     {
         // MOD NOTE1  check to see if path exists - otherwise it later tries to
         //  remove nullptr fm with inotify which caused segfault
-        VFSFileMonitor* fm;
-        if (std::filesystem::exists(caches[i]->file_path))
-            fm = vfs_file_monitor_add(caches[i]->file_path, on_mime_cache_changed, caches[i]);
-        else
-            fm = nullptr;
-        mime_caches_monitor[i] = fm;
+        if (!std::filesystem::exists(file))
+            continue;
+        VFSFileMonitor* fm = vfs_file_monitor_add(file.data(), on_mime_cache_changed, nullptr);
+        if (fm)
+            mime_caches_monitor.push_back(fm);
     }
-    mime_hash = g_hash_table_new_full(g_str_hash, g_str_equal, nullptr, vfs_mime_type_unref);
+
+    /* association lists and desktop files */
+    std::vector<std::string> apps_dirs;
+    apps_dirs.emplace_back(vfs_user_config_dir());
+    apps_dirs.emplace_back(vfs_build_path(vfs_user_data_dir(), "applications"));
+    for (const char* const* dir = vfs_system_data_dir(); *dir; ++dir)
+        apps_dirs.emplace_back(vfs_build_path(*dir, "applications"));
+    for (std::size_t i = 0; i < apps_dirs.size(); ++i)
+    {
+        // see NOTE1
+        if (!std::filesystem::is_directory(apps_dirs[i]))
+            continue;
+        // ~/.config is only watched for mimeapps.list
+        apps_dir_monitor_add(apps_dirs[i], i != 0);
+    }
+
+    mime_registry.store(mime_registry_new(MIME_REGISTRY_SIZE), std::memory_order_release);
     GtkIconTheme* theme = gtk_icon_theme_get_default();
     theme_change_notify =
         g_signal_connect(theme, "changed", G_CALLBACK(on_icon_theme_changed), nullptr);
@@ -132,19 +324,21 @@ vfs_mime_type_clean()
     g_signal_handler_disconnect(theme, theme_change_notify);
 
     /* remove file alteration monitor for mime-cache */
-    int n_caches;
-    MimeCache** caches = mime_type_get_caches(&n_caches);
-    int i;
-    for (i = 0; i < n_caches; ++i)
-    {
-        if (mime_caches_monitor[i]) // MOD added if !nullptr - see NOTE1 above
-            vfs_file_monitor_remove(mime_caches_monitor[i], on_mime_cache_changed, caches[i]);
-    }
-    g_free(mime_caches_monitor);
+    for (VFSFileMonitor* fm: mime_caches_monitor)
+        vfs_file_monitor_remove(fm, on_mime_cache_changed, nullptr);
+    mime_caches_monitor.clear();
+    for (VFSFileMonitor* fm: apps_dirs_monitor)
+        vfs_file_monitor_remove(fm, on_apps_dir_changed, nullptr);
+    apps_dirs_monitor.clear();
 
     mime_type_finalize();
+    vfs_icon_cache_clear();
 
-    g_hash_table_destroy(mime_hash);
+    std::lock_guard<std::mutex> lock(mime_registry_lock);
+    for (VFSMimeRegistry* registry: retired_registries)
+        mime_registry_free(registry);
+    retired_registries.clear();
+    mime_registry_free(mime_registry.exchange(nullptr));
 }
 
 VFSMimeType*
@@ -162,19 +356,40 @@ vfs_mime_type_get_from_file(const char* file_path, const char* base_name, struct
     return vfs_mime_type_get_from_type(type);
 }
 
+VFSMimeType*
+vfs_mime_type_get_from_file_no_content(const char* file_path, const char* base_name,
+                                       struct stat* pstat)
+{
+    const char* type = mime_type_get_by_file_no_content(file_path, pstat, base_name);
+    return type ? vfs_mime_type_get_from_type(type) : nullptr;
+}
+
 VFSMimeType*
 vfs_mime_type_get_from_type(const char* type)
 {
-    g_rw_lock_reader_lock(&mime_hash_lock);
-    VFSMimeType* mime_type = static_cast<VFSMimeType*>(g_hash_table_lookup(mime_hash, type));
-    g_rw_lock_reader_unlock(&mime_hash_lock);
+    std::size_t hash = g_str_hash(type);
+
+    /* the table and its entries stay alive until the ref is taken */
+    mime_registry_readers.fetch_add(1);
+    VFSMimeType* mime_type = mime_registry_find(mime_registry.load(), type, hash);
+    if (mime_type)
+        vfs_mime_type_ref(mime_type);
+    if (mime_registry_readers.fetch_sub(1) == 1 && mime_registry_has_retired.load())
+    {
+        std::unique_lock<std::mutex> lock(mime_registry_lock, std::try_to_lock);
+        if (lock.owns_lock())
+            mime_registry_reclaim();
+    }
+    if (mime_type)
+        return mime_type;
 
+    std::lock_guard<std::mutex> lock(mime_registry_lock);
+    // another thread may have added it meanwhile
+    mime_type = mime_registry_find(mime_registry.load(std::memory_order_relaxed), type, hash);
     if (!mime_type)
     {
         mime_type = vfs_mime_type_new(type);
-        g_rw_lock_reader_lock(&mime_hash_lock);
-        g_hash_table_insert(mime_hash, mime_type->type, mime_type);
-        g_rw_lock_writer_unlock(&mime_hash_lock);
+        mime_registry_add(mime_registry_reserve(), mime_type, hash);
     }
     vfs_mime_type_ref(mime_type);
     return mime_type;
@@ -199,8 +414,8 @@ void
 vfs_mime_type_unref(void* mime_type_)
 {
     VFSMimeType* mime_type = static_cast<VFSMimeType*>(mime_type_);
-    mime_type->ref_dec();
-    if (mime_type->ref_count() == 0)
+    /* the decrement tells which thread dropped the last ref */
+    if (mime_type->ref_dec() == 0)
     {
         g_free(mime_type->type);
         if (mime_type->big_icon)
@@ -340,11 +555,8 @@ vfs_mime_type_get_icon(VFSMimeType* mime_type, bool big)
 }
 
 static void
-free_cached_icons(void* key, void* value, void* user_data)
+free_cached_icons(VFSMimeType* mime_type, bool big)
 {
-    (void)key;
-    VFSMimeType* mime_type = static_cast<VFSMimeType*>(value);
-    bool big = GPOINTER_TO_INT(user_data);
     if (big)
     {
         if (mime_type->big_icon)
@@ -363,23 +575,33 @@ free_cached_icons(void* key, void* value, void* user_data)
     }
 }
 
+/* Unload old cached icons of all registered types */
+static void
+mime_registry_free_cached_icons(bool big)
+{
+    std::lock_guard<std::mutex> lock(mime_registry_lock);
+    VFSMimeRegistry* registry = mime_registry.load(std::memory_order_relaxed);
+    for (std::atomic<VFSMimeType*>& slot: registry->slots)
+    {
+        VFSMimeType* mime_type = slot.load(std::memory_order_relaxed);
+        if (mime_type)
+            free_cached_icons(mime_type, big);
+    }
+}
+
 void
 vfs_mime_type_set_icon_size(int big, int small)
 {
-    g_rw_lock_reader_lock(&mime_hash_lock);
     if (big != big_icon_size)
     {
         big_icon_size = big;
-        /* Unload old cached icons */
-        g_hash_table_foreach(mime_hash, free_cached_icons, GINT_TO_POINTER(1));
+        mime_registry_free_cached_icons(true);
     }
     if (small != small_icon_size)
     {
         small_icon_size = small;
-        /* Unload old cached icons */
-        g_hash_table_foreach(mime_hash, free_cached_icons, GINT_TO_POINTER(0));
+        mime_registry_free_cached_icons(false);
     }
-    g_rw_lock_writer_unlock(&mime_hash_lock);
 }
 
 void
@@ -522,13 +744,11 @@ on_icon_theme_changed(GtkIconTheme* icon_theme, void* user_data)
 {
     (void)icon_theme;
     (void)user_data;
+    // connected in vfs_mime_type_init(), before any handler that reloads icons
+    vfs_icon_cache_clear();
     /* reload_mime_icons */
-    g_rw_lock_reader_lock(&mime_hash_lock);
-
-    g_hash_table_foreach(mime_hash, free_cached_icons, GINT_TO_POINTER(1));
-    g_hash_table_foreach(mime_hash, free_cached_icons, GINT_TO_POINTER(0));
-
-    g_rw_lock_writer_unlock(&mime_hash_lock);
+    mime_registry_free_cached_icons(true);
+    mime_registry_free_cached_icons(false);
 }
 
 GList*
@@ -566,10 +786,10 @@ VFSMimeType::ref_inc()
     ++n_ref;
 }
 
-void
+unsigned int
 VFSMimeType::ref_dec()
 {
-    --n_ref;
+    return --n_ref;
 }
 
 unsigned int
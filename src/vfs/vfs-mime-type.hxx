@@ -26,7 +26,7 @@ struct VFSMimeType
     GdkPixbuf* small_icon;
 
     void ref_inc();
-    void ref_dec();
+    unsigned int ref_dec(); /* returns the refs left */
     unsigned int ref_count();
 
   private:
@@ -44,6 +44,11 @@ VFSMimeType* vfs_mime_type_get_from_file(const char* file_path, /* Should be on-
                                          const char* base_name, /* Should be in UTF-8 */
                                          struct stat* pstat);   /* Can be nullptr */
 
+/* same as vfs_mime_type_get_from_file without reading the file,
+ * returns nullptr if only its content could tell the mime type */
+VFSMimeType* vfs_mime_type_get_from_file_no_content(const char* file_path, const char* base_name,
+                                                    struct stat* pstat);
+
 VFSMimeType* vfs_mime_type_get_from_type(const char* type);
 
 VFSMimeType* vfs_mime_type_new(const char* type_name);
@@ -0,0 +1,183 @@
+/*
+ *  C Implementation: vfs-owner-cache
+ *
+ * Description: Cached user and group name lookups
+ *
+ *
+ *
+ * Copyright: See COPYING file that comes with this distribution
+ *
+ */
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+
+#include <pwd.h>
+#include <grp.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "vfs/vfs-owner-cache.hxx"
+
+using Clock = std::chrono::steady_clock;
+
+struct OwnerCacheEntry
+{
+    std::string name;
+    unsigned int id;
+    bool found;
+    Clock::time_point expires;
+};
+
+/* one lock for all maps, lookups are rare once the cache is warm */
+static std::mutex owner_cache_lock;
+static std::unordered_map<uid_t, OwnerCacheEntry> user_names;
+static std::unordered_map<gid_t, OwnerCacheEntry> group_names;
+static std::unordered_map<std::string, OwnerCacheEntry> user_ids;
+static std::unordered_map<std::string, OwnerCacheEntry> group_ids;
+
+static std::size_t
+nss_buf_size(int name)
+{
+    long size = sysconf(name);
+    return size > 0 ? size : 16384;
+}
+
+static OwnerCacheEntry
+lookup_uid(uid_t uid)
+{
+    OwnerCacheEntry entry{std::to_string(uid), uid, false, Clock::now()};
+    std::vector<char> buf(nss_buf_size(_SC_GETPW_R_SIZE_MAX));
+    struct passwd pwd;
+    struct passwd* result = nullptr;
+    if (getpwuid_r(uid, &pwd, buf.data(), buf.size(), &result) == 0 && result &&
+        result->pw_name && *result->pw_name)
+    {
+        entry.name = result->pw_name;
+        entry.found = true;
+    }
+    return entry;
+}
+
+static OwnerCacheEntry
+lookup_gid(gid_t gid)
+{
+    OwnerCacheEntry entry{std::to_string(gid), gid, false, Clock::now()};
+    std::vector<char> buf(nss_buf_size(_SC_GETGR_R_SIZE_MAX));
+    struct group grp;
+    struct group* result = nullptr;
+    if (getgrgid_r(gid, &grp, buf.data(), buf.size(), &result) == 0 && result &&
+        result->gr_name && *result->gr_name)
+    {
+        entry.name = result->gr_name;
+        entry.found = true;
+    }
+    return entry;
+}
+
+static OwnerCacheEntry
+lookup_user_name(const std::string& user_name)
+{
+    OwnerCacheEntry entry{user_name, (unsigned int)-1, false, Clock::now()};
+    std::vector<char> buf(nss_buf_size(_SC_GETPW_R_SIZE_MAX));
+    struct passwd pwd;
+    struct passwd* result = nullptr;
+    if (getpwnam_r(user_name.c_str(), &pwd, buf.data(), buf.size(), &result) == 0 && result)
+    {
+        entry.id = result->pw_uid;
+        entry.found = true;
+    }
+    return entry;
+}
+
+static OwnerCacheEntry
+lookup_group_name(const std::string& group_name)
+{
+    OwnerCacheEntry entry{group_name, (unsigned int)-1, false, Clock::now()};
+    std::vector<char> buf(nss_buf_size(_SC_GETGR_R_SIZE_MAX));
+    struct group grp;
+    struct group* result = nullptr;
+    if (getgrnam_r(group_name.c_str(), &grp, buf.data(), buf.size(), &result) == 0 && result)
+    {
+        entry.id = result->gr_gid;
+        entry.found = true;
+    }
+    return entry;
+}
+
+/*
+ * Return the cached entry for key, looking it up if missing or expired.
+ * The lookup runs without the lock held so a slow NSS backend does
+ * not block other threads; concurrent misses may both query it.
+ * Unless cache_misses, a key with no account is looked up every time.
+ */
+template<typename K, typename F>
+static const OwnerCacheEntry
+owner_cache_get(std::unordered_map<K, OwnerCacheEntry>& map, const K& key, F lookup,
+                bool cache_misses)
+{
+    {
+        std::lock_guard<std::mutex> lock(owner_cache_lock);
+        auto it = map.find(key);
+        if (it != map.end() && it->second.expires > Clock::now())
+            return it->second;
+    }
+
+    OwnerCacheEntry entry = lookup(key);
+    entry.expires = Clock::now() + std::chrono::seconds(VFS_OWNER_CACHE_TTL);
+
+    std::lock_guard<std::mutex> lock(owner_cache_lock);
+    if (entry.found || cache_misses)
+        map.insert_or_assign(key, entry);
+    else
+        map.erase(key);
+    return entry;
+}
+
+/* numeric names are accepted when there is no account with that name */
+static unsigned int
+parse_id(const char* name)
+{
+    unsigned int id = 0;
+    for (const char* p = name; *p; ++p)
+    {
+        if (!g_ascii_isdigit(*p))
+            return -1;
+        id = id * 10 + (*p - '0');
+    }
+    return id;
+}
+
+const std::string
+vfs_owner_cache_user_name(uid_t uid)
+{
+    // files of deleted accounts are common, so their ids are cached too
+    return owner_cache_get(user_names, uid, lookup_uid, true).name;
+}
+
+const std::string
+vfs_owner_cache_group_name(gid_t gid)
+{
+    return owner_cache_get(group_names, gid, lookup_gid, true).name;
+}
+
+uid_t
+vfs_owner_cache_uid(const char* user_name)
+{
+    const OwnerCacheEntry entry =
+        // a name is typed in after creating the account, a miss must not stick
+        owner_cache_get(user_ids, std::string(user_name), lookup_user_name, false);
+    return entry.found ? entry.id : parse_id(user_name);
+}
+
+gid_t
+vfs_owner_cache_gid(const char* group_name)
+{
+    const OwnerCacheEntry entry =
+        owner_cache_get(group_ids, std::string(group_name), lookup_group_name, false);
+    return entry.found ? entry.id : parse_id(group_name);
+}
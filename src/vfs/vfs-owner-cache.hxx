@@ -0,0 +1,32 @@
+/*
+ *  C Interface: vfs-owner-cache
+ *
+ * Description: Cached user and group name lookups
+ *
+ *
+ *
+ * Copyright: See COPYING file that comes with this distribution
+ *
+ */
+
+#pragma once
+
+#include <string>
+
+#include <sys/types.h>
+
+/* seconds before a cached lookup is repeated, accounts may come from LDAP/NSS */
+#define VFS_OWNER_CACHE_TTL 300
+
+/*
+ * Names of uid and gid, or the number as a string if there is no such
+ * account. Results are shared by all threads and cached for
+ * VFS_OWNER_CACHE_TTL seconds, so NSS is not queried for every file.
+ */
+const std::string vfs_owner_cache_user_name(uid_t uid);
+const std::string vfs_owner_cache_group_name(gid_t gid);
+
+/* Reverse lookups, returns -1 if there is no such account.
+ * Only names that were found are cached. */
+uid_t vfs_owner_cache_uid(const char* user_name);
+gid_t vfs_owner_cache_gid(const char* group_name);
@@ -0,0 +1,306 @@
+/*
+ *  C Implementation: vfs-statx-batch
+ *
+ * Description: Batched lstat of directory entries
+ *
+ *
+ *
+ * Copyright: See COPYING file that comes with this distribution
+ *
+ */
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/sysmacros.h>
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+#include "logger.hxx"
+
+#include "vfs/vfs-statx-batch.hxx"
+
+struct VFSStatxBatch
+{
+    int dirfd;
+    VFSStatxBatchFunc func;
+    void* user_data;
+
+    std::vector<std::string> names;
+
+#ifdef HAVE_LIBURING
+    bool allow_uring; // vfs_statx_batch_use_uring()
+    bool uring_tried; // ring is set up for the first batch big enough
+    bool use_uring;
+    struct io_uring ring;
+    std::vector<struct statx> results;
+#endif
+};
+
+#ifdef HAVE_LIBURING
+/* smaller batches are stat'ed synchronously, setting up a ring costs more
+ * than it saves, so small dirs never get one */
+#define VFS_STATX_URING_MIN 32
+
+/* Buffers of io_uring requests that were still in flight when their ring
+ * had to be given up. The kernel may read the names or write the results
+ * at any later time, so they are kept until the process exits. */
+struct VFSStatxAbandoned
+{
+    std::vector<std::string> names;
+    std::vector<struct statx> results;
+};
+
+static std::mutex abandoned_lock;
+static std::vector<std::unique_ptr<VFSStatxAbandoned>> abandoned;
+#endif
+
+#ifdef HAVE_LIBURING
+static bool
+uring_supports_statx(struct io_uring* ring)
+{
+    struct io_uring_probe* probe = io_uring_get_probe_ring(ring);
+    if (!probe)
+        return false;
+    bool ret = io_uring_opcode_supported(probe, IORING_OP_STATX);
+    io_uring_free_probe(probe);
+    return ret;
+}
+
+static void
+statx_to_stat(const struct statx* stx, struct stat* file_stat)
+{
+    memset(file_stat, 0, sizeof(struct stat));
+    file_stat->st_dev = makedev(stx->stx_dev_major, stx->stx_dev_minor);
+    file_stat->st_ino = stx->stx_ino;
+    file_stat->st_mode = stx->stx_mode;
+    file_stat->st_nlink = stx->stx_nlink;
+    file_stat->st_uid = stx->stx_uid;
+    file_stat->st_gid = stx->stx_gid;
+    file_stat->st_rdev = makedev(stx->stx_rdev_major, stx->stx_rdev_minor);
+    file_stat->st_size = stx->stx_size;
+    file_stat->st_blksize = stx->stx_blksize;
+    file_stat->st_blocks = stx->stx_blocks;
+    file_stat->st_atim.tv_sec = stx->stx_atime.tv_sec;
+    file_stat->st_atim.tv_nsec = stx->stx_atime.tv_nsec;
+    file_stat->st_mtim.tv_sec = stx->stx_mtime.tv_sec;
+    file_stat->st_mtim.tv_nsec = stx->stx_mtime.tv_nsec;
+    file_stat->st_ctim.tv_sec = stx->stx_ctime.tv_sec;
+    file_stat->st_ctim.tv_nsec = stx->stx_ctime.tv_nsec;
+}
+#endif
+
+VFSStatxBatch*
+vfs_statx_batch_new(int dirfd, VFSStatxBatchFunc func, void* user_data)
+{
+    VFSStatxBatch* batch = new VFSStatxBatch;
+    batch->dirfd = dirfd;
+    batch->func = func;
+    batch->user_data = user_data;
+    batch->names.reserve(VFS_STATX_BATCH_SIZE);
+
+#ifdef HAVE_LIBURING
+    batch->allow_uring = true;
+    batch->uring_tried = false;
+    batch->use_uring = false;
+#endif
+    return batch;
+}
+
+void
+vfs_statx_batch_use_uring(VFSStatxBatch* batch, bool use_uring)
+{
+#ifdef HAVE_LIBURING
+    batch->allow_uring = use_uring;
+#else
+    (void)batch;
+    (void)use_uring;
+#endif
+}
+
+void
+vfs_statx_batch_free(VFSStatxBatch* batch)
+{
+#ifdef HAVE_LIBURING
+    if (batch->use_uring)
+        io_uring_queue_exit(&batch->ring);
+#endif
+    delete batch;
+}
+
+static void
+statx_batch_sync(VFSStatxBatch* batch, const char* name)
+{
+    struct stat file_stat;
+    if (fstatat(batch->dirfd, name, &file_stat, AT_SYMLINK_NOFOLLOW) == 0)
+        batch->func(name, &file_stat, batch->user_data);
+}
+
+#ifdef HAVE_LIBURING
+static void
+statx_batch_uring_init(VFSStatxBatch* batch)
+{
+    batch->uring_tried = true;
+    if (io_uring_queue_init(VFS_STATX_BATCH_SIZE, &batch->ring, 0) != 0)
+        return;
+    if (!uring_supports_statx(&batch->ring))
+    {
+        // kernel has io_uring but no IORING_OP_STATX (< 5.6)
+        io_uring_queue_exit(&batch->ring);
+        return;
+    }
+    batch->use_uring = true;
+    batch->results.resize(VFS_STATX_BATCH_SIZE);
+}
+
+/* Gives up on io_uring for this batch after an error. The buffers of
+ * requests still in flight go to the abandoned list, the batch goes on
+ * with a copy of the names. */
+static void
+statx_batch_uring_drop(VFSStatxBatch* batch, std::size_t in_flight)
+{
+    io_uring_queue_exit(&batch->ring);
+    batch->use_uring = false;
+    if (in_flight == 0)
+        return;
+
+    LOG_WARN("io_uring dropped with {} statx in flight", in_flight);
+    // moving the vectors keeps the strings and results where the kernel has them
+    std::unique_ptr<VFSStatxAbandoned> held = std::make_unique<VFSStatxAbandoned>();
+    held->names = std::move(batch->names);
+    held->results = std::move(batch->results);
+    batch->names = held->names;
+
+    const std::lock_guard<std::mutex> lock(abandoned_lock);
+    abandoned.push_back(std::move(held));
+}
+
+static void
+statx_batch_uring(VFSStatxBatch* batch)
+{
+    const std::size_t n = batch->names.size();
+    std::vector<bool> done(n, false);
+
+    std::size_t prepared = 0;
+    for (; prepared < n; ++prepared)
+    {
+        // anything left over goes the synchronous way
+        struct io_uring_sqe* sqe = io_uring_get_sqe(&batch->ring);
+        if (!sqe)
+            break;
+        io_uring_prep_statx(sqe,
+                            batch->dirfd,
+                            batch->names[prepared].c_str(),
+                            AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT,
+                            STATX_BASIC_STATS,
+                            &batch->results[prepared]);
+        io_uring_sqe_set_data(sqe, (void*)(uintptr_t)prepared);
+    }
+
+    // a short submit leaves the rest in the submission queue for the next call
+    bool failed = false;
+    std::size_t submitted = 0;
+    while (submitted < prepared)
+    {
+        int ret;
+        while ((ret = io_uring_submit(&batch->ring)) == -EINTR)
+            ;
+        if (ret <= 0)
+        {
+            LOG_WARN("io_uring_submit failed: {}", std::strerror(ret < 0 ? -ret : EIO));
+            failed = true;
+            break;
+        }
+        submitted += ret;
+    }
+    std::size_t in_flight = submitted;
+
+    // every submitted request has to be reaped before its buffers can be reused
+    while (in_flight > 0)
+    {
+        struct io_uring_cqe* cqe;
+        int ret;
+        while ((ret = io_uring_wait_cqe(&batch->ring, &cqe)) == -EINTR)
+            ;
+        if (ret < 0)
+        {
+            LOG_WARN("io_uring_wait_cqe failed: {}", std::strerror(-ret));
+            failed = true;
+            break;
+        }
+
+        std::size_t i = (uintptr_t)io_uring_cqe_get_data(cqe);
+        int res = cqe->res;
+        io_uring_cqe_seen(&batch->ring, cqe);
+        if (i >= prepared || done[i])
+        {
+            // not one of ours, the ring can no longer be trusted
+            LOG_WARN("io_uring returned an unknown statx completion: {}", i);
+            failed = true;
+            break;
+        }
+        --in_flight;
+
+        done[i] = true;
+        if (res == 0)
+        {
+            struct stat file_stat;
+            statx_to_stat(&batch->results[i], &file_stat);
+            batch->func(batch->names[i].c_str(), &file_stat, batch->user_data);
+        }
+        else if (res != -ENOENT)
+        {
+            // let the synchronous path decide what this error means
+            statx_batch_sync(batch, batch->names[i].c_str());
+        }
+        // else file was removed since it was listed
+    }
+
+    if (failed)
+        statx_batch_uring_drop(batch, in_flight);
+
+    // anything not prepared, not submitted or not completed
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        if (!done[i])
+            statx_batch_sync(batch, batch->names[i].c_str());
+    }
+}
+#endif
+
+void
+vfs_statx_batch_flush(VFSStatxBatch* batch)
+{
+    if (batch->names.empty())
+        return;
+
+#ifdef HAVE_LIBURING
+    if (!batch->uring_tried && batch->allow_uring && batch->names.size() >= VFS_STATX_URING_MIN)
+        statx_batch_uring_init(batch);
+    if (batch->use_uring && batch->allow_uring)
+        statx_batch_uring(batch);
+    else
+#endif
+    {
+        for (const std::string& name: batch->names)
+            statx_batch_sync(batch, name.c_str());
+    }
+    batch->names.clear();
+}
+
+void
+vfs_statx_batch_add(VFSStatxBatch* batch, const char* name)
+{
+    batch->names.emplace_back(name);
+    if (batch->names.size() >= VFS_STATX_BATCH_SIZE)
+        vfs_statx_batch_flush(batch);
+}
@@ -0,0 +1,39 @@
+/*
+ *  C Interface: vfs-statx-batch
+ *
+ * Description: Batched lstat of directory entries
+ *
+ *
+ *
+ * Copyright: See COPYING file that comes with this distribution
+ *
+ */
+
+#pragma once
+
+#include <sys/stat.h>
+
+/* number of entries queued before a batch is submitted */
+#define VFS_STATX_BATCH_SIZE 256
+
+/* called once for every queued entry that still exists */
+typedef void (*VFSStatxBatchFunc)(const char* name, struct stat* file_stat, void* user_data);
+
+struct VFSStatxBatch;
+
+/*
+ * Entries are stat'ed relative to dirfd, which must stay open until the
+ * batch is freed. With io_uring support a whole batch is submitted as
+ * IORING_OP_STATX requests and func is called from the completions,
+ * otherwise each entry falls back to a synchronous fstatat(). The ring is
+ * only set up once a batch is big enough to be worth it.
+ */
+VFSStatxBatch* vfs_statx_batch_new(int dirfd, VFSStatxBatchFunc func, void* user_data);
+void vfs_statx_batch_free(VFSStatxBatch* batch);
+
+/* false stats every entry with fstatat(), used to compare both ways */
+void vfs_statx_batch_use_uring(VFSStatxBatch* batch, bool use_uring);
+
+/* queue an entry, the batch is flushed automatically when full */
+void vfs_statx_batch_add(VFSStatxBatch* batch, const char* name);
+void vfs_statx_batch_flush(VFSStatxBatch* batch);
@@ -19,14 +19,23 @@
  *      MA 02110-1301, USA.
  */
 
+#include <string>
+#include <unordered_map>
+
+#include <mutex>
+
 #include "vfs/vfs-utils.hxx"
 
-GdkPixbuf*
-vfs_load_icon(GtkIconTheme* theme, const char* icon_name, int size)
-{
-    if (!icon_name)
-        return nullptr;
+/* Icons of the default theme by size and name, shared by mime types,
+ * desktop entries, bookmarks and devices. nullptr if the theme has no such icon. */
+#define VFS_ICON_CACHE_MAX 4096
+
+static std::unordered_map<std::string, GdkPixbuf*> icon_cache;
+static std::mutex icon_cache_lock;
 
+static GdkPixbuf*
+vfs_load_icon_from_theme(GtkIconTheme* theme, const char* icon_name, int size)
+{
     GtkIconInfo* inf = gtk_icon_theme_lookup_icon(
         theme,
         icon_name,
@@ -52,3 +61,55 @@ vfs_load_icon(GtkIconTheme* theme, const char* icon_name, int size)
 
     return icon;
 }
+
+static void
+icon_cache_free()
+{
+    for (const auto& [key, icon]: icon_cache)
+    {
+        if (icon)
+            g_object_unref(icon);
+    }
+    icon_cache.clear();
+}
+
+GdkPixbuf*
+vfs_load_icon(GtkIconTheme* theme, const char* icon_name, int size)
+{
+    if (!icon_name)
+        return nullptr;
+
+    if (theme != gtk_icon_theme_get_default())
+        return vfs_load_icon_from_theme(theme, icon_name, size);
+
+    std::string key = std::to_string(size);
+    key.append(1, ':').append(icon_name);
+    {
+        std::lock_guard<std::mutex> lock(icon_cache_lock);
+        auto it = icon_cache.find(key);
+        if (it != icon_cache.end())
+            return it->second ? g_object_ref(it->second) : nullptr;
+    }
+
+    // loaded unlocked, the thumbnail loader threads ask for icons too
+    GdkPixbuf* icon = vfs_load_icon_from_theme(theme, icon_name, size);
+
+    std::lock_guard<std::mutex> lock(icon_cache_lock);
+    if (G_UNLIKELY(icon_cache.size() >= VFS_ICON_CACHE_MAX))
+        icon_cache_free();
+    auto [it, inserted] = icon_cache.emplace(key, icon);
+    if (!inserted) // another thread was faster
+    {
+        if (icon)
+            g_object_unref(icon);
+        icon = it->second;
+    }
+    return icon ? g_object_ref(icon) : nullptr;
+}
+
+void
+vfs_icon_cache_clear()
+{
+    std::lock_guard<std::mutex> lock(icon_cache_lock);
+    icon_cache_free();
+}
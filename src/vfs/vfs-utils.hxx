@@ -24,4 +24,9 @@
 #include <gtk/gtk.h>
 #include <glib.h>
 
+/* Icons of the default theme are cached, the returned pixbuf is shared
+ * and must not be modified */
 GdkPixbuf* vfs_load_icon(GtkIconTheme* theme, const char* icon_name, int size);
+
+/* drop all cached icons, the icon theme changed */
+void vfs_icon_cache_clear();
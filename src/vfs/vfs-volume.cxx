@@ -40,6 +40,9 @@
 #define HIDDEN_NON_BLOCK_FS                                                                    \
     "devpts proc fusectl pstore sysfs tmpfs devtmpfs ramfs aufs overlayfs cgroup binfmt_misc " \
     "rpc_pipefs fuse.gvfsd-fuse"
+#define NETWORK_FS                                                                             \
+    "nfs nfs4 cifs smb3 smbfs ncpfs 9p afs ceph glusterfs lustre davfs ftpfs fuse.sshfs "     \
+    "fuse.curlftpfs fuse.rclone fuse.davfs2 fuse.s3fs"
 
 static VFSVolume* vfs_volume_read_by_device(struct udev_device* udevice);
 static VFSVolume* vfs_volume_read_by_mount(dev_t devnum, const char* mount_points);
@@ -4123,6 +4126,36 @@ vfs_volume_dir_avoid_changes(const char* dir)
     return ret;
 }
 
+bool
+vfs_volume_dir_is_network(const char* dir)
+{
+    // determines if dir is on a network filesystem, where every stat call
+    // is a round trip to the server (eg nfs, cifs, sshfs)
+    if (!dir)
+        return false;
+
+    struct stat stat_buf; // skip stat
+    if (stat(dir, &stat_buf) == -1)
+        return false;
+
+    const char* fstype = get_devmount_fstype(major(stat_buf.st_dev), minor(stat_buf.st_dev));
+    if (!fstype || !fstype[0])
+        return false;
+
+    int len = strlen(fstype);
+    const char* ptr = NETWORK_FS;
+    while (ptr[0])
+    {
+        while (ptr[0] == ' ')
+            ptr++;
+        if (g_str_has_prefix(ptr, fstype) && (ptr[len] == ' ' || ptr[len] == '\0'))
+            return true;
+        while (ptr[0] != ' ' && ptr[0])
+            ptr++;
+    }
+    return false;
+}
+
 dev_t
 get_device_parent(dev_t dev)
 {
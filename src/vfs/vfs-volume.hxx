@@ -121,6 +121,7 @@ char* vfs_volume_handler_cmd(int mode, int action, VFSVolume* vol, const char* o
 
 int split_network_url(const char* url, netmount_t** netmount);
 bool vfs_volume_dir_avoid_changes(const char* dir);
+bool vfs_volume_dir_is_network(const char* dir);
 dev_t get_device_parent(dev_t dev);
 bool path_is_mounted_mtab(const char* mtab_file, const char* path, char** device_file,
                           char** fs_type);